@@ -105,6 +105,15 @@ This information includes:
   #define CPU_CLOCK 240000000
 #endif
 
+/// Clock used for the nominal GPIO delay estimate, until the delay loop is calibrated.
+#ifdef CONFIG_IDF_TARGET_ESP8266
+  #define BUS_CLOCK_FIXED 80000000
+#elif defined CONFIG_IDF_TARGET_ESP32 || defined CONFIG_IDF_TARGET_ESP32S3
+  #define BUS_CLOCK_FIXED 100000000
+#elif defined CONFIG_IDF_TARGET_ESP32C3
+  #define BUS_CLOCK_FIXED 80000000
+#endif
+
 
 
 //#define MAX_USER_CLOCK 16000000 ///< Specifies the max Debug Clock in Hz.
@@ -395,6 +404,17 @@ __STATIC_INLINE uint8_t DAP_GetProductFirmwareVersionString (char *str) {
 #error "not a supported target"
 #endif
 
+// Gang programming buses, {SWCLK, SWDIO out, SWDIO in} per bus.
+// The first bus is the normal SWD port, the other pins must be below GPIO32.
+#if (USE_SWD_GANG == 1)
+  #define SWD_GANG_BUS_CNT 2
+  #if defined CONFIG_IDF_TARGET_ESP32
+    #define SWD_GANG_PINS { { PIN_SWCLK, PIN_SWDIO_MOSI, PIN_SWDIO }, { 22, 21, 21 } }
+  #elif defined CONFIG_IDF_TARGET_ESP32S3
+    #define SWD_GANG_PINS { { PIN_SWCLK, PIN_SWDIO_MOSI, PIN_SWDIO_MOSI }, { 16, 15, 15 } }
+  #endif
+#endif
+
 
 //**************************************************************************************************
 /**
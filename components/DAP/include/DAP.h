@@ -208,6 +208,7 @@
 #define DP_SELECT                       0x08U   // Select Register (JTAG R/W & SW W)
 #define DP_RESEND                       0x08U   // Resend (SW Read Only)
 #define DP_RDBUFF                       0x0CU   // Read Buffer (Read Only)
+#define DP_TARGETSEL                    0x0CU   // Target Select (SW Write Only)
 
 // JTAG IR Codes
 #define JTAG_ABORT                      0x08U
@@ -258,7 +259,9 @@ typedef struct {
     uint8_t   ir_length[DAP_JTAG_DEV_CNT];      // IR Length in bits
     uint16_t  ir_before[DAP_JTAG_DEV_CNT];      // Bits before IR
     uint16_t  ir_after [DAP_JTAG_DEV_CNT];      // Bits after IR
+    uint32_t  ir_cache [DAP_JTAG_DEV_CNT];      // Last IR value of each device
 #endif
+    uint8_t   ir_valid;                         // IR cache is valid
   } jtag_dev;
 #endif
 } DAP_Data_t;
@@ -270,7 +273,8 @@ extern volatile uint8_t    DAP_TransferAbort;   // Transfer Abort Flag
 enum transfer_type {
   kTransfer_GPIO_normal,
   kTransfer_GPIO_fast,
-  kTransfer_SPI
+  kTransfer_SPI,
+  kTransfer_JTAG_SPI
 };
 
 extern uint8_t SWD_TransferSpeed;
@@ -288,7 +292,13 @@ extern void     JTAG_IR         (uint32_t ir);
 extern uint32_t JTAG_ReadIDCode (void);
 extern void     JTAG_WriteAbort (uint32_t data);
 extern uint8_t  JTAG_Transfer   (uint32_t request, uint32_t *data);
+extern uint64_t JTAG_DR         (uint32_t count, uint64_t tdi, uint32_t idle);
 extern uint8_t  SWD_Transfer    (uint32_t request, uint32_t *data);
+extern uint8_t  SWD_TransferStream (uint32_t request, const uint8_t *data, uint32_t count);
+extern uint8_t  SWD_GetSelect   (uint32_t *select);
+extern void     SWD_InvalidateSelect (void);
+extern void     SWD_WriteTargetSel (uint32_t targetsel);
+extern uint8_t  SWD_GetTargetSel   (uint32_t *targetsel);
 
 extern void     Delayms         (uint32_t delay);
 
@@ -330,6 +340,21 @@ extern uint32_t DAP_ExecuteCommand       (const uint8_t *request, uint8_t *respo
 
 extern void     DAP_Setup (void);
 
+// SWD/JTAG clock calibration (GPIO engines)
+typedef struct {
+  uint32_t delay_ps;            // Duration of one PIN_DELAY_SLOW() iteration
+  uint32_t overhead_ps;         // Half clock period of the Slow engine without delay
+  uint32_t fast_clock;          // Clock generated by the Fast engine in Hz
+} SWJ_Calibration_t;
+
+extern SWJ_Calibration_t SWJ_Calibration;
+extern void     SWJ_Calibrate (void);
+
+// Nominal clock of the Fast engine, used when no calibration is available
+#ifndef SWJ_FAST_CLOCK_NOMINAL
+#define SWJ_FAST_CLOCK_NOMINAL  2000000U
+#endif
+
 // Configurable delay for clock generation
 #ifndef DELAY_SLOW_CYCLES
 #define DELAY_SLOW_CYCLES       3U      // Number of cycles for one iteration
@@ -16,6 +16,12 @@
 
 extern const uint8_t kParityByteTable[256];
 
+// CRC-32 (IEEE 802.3, as zlib), start with 0 and pass the previous result to continue
+extern uint32_t Crc32(uint32_t crc, const uint8_t *data, uint32_t size);
+
+// Decode one LZ4 block (no frame header), return the decoded size or -1 when the block is invalid
+extern int Lz4DecodeBlock(const uint8_t *src, uint32_t src_size, uint8_t *dst, uint32_t dst_size);
+
 __STATIC_FORCEINLINE uint8_t ParityEvenUint32(uint32_t v)
 {
     v ^= v >> 16;
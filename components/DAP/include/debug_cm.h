@@ -64,6 +64,7 @@
 
 // Debug Select Register definitions
 #define CTRLSEL        0x00000001  // CTRLSEL (SW Only)
+#define DPBANKSEL      0x0000000F  // DPBANKSEL Mask
 #define APBANKSEL      0x000000F0  // APBANKSEL Mask
 #define APSEL          0xFF000000  // APSEL Mask
 
@@ -0,0 +1,20 @@
+#ifndef __MEM_CACHE_H__
+#define __MEM_CACHE_H__
+
+#include <stdint.h>
+
+// Memory Cache command
+#define MEM_CACHE_FLUSH         0U  // drop the cached data
+#define MEM_CACHE_ADD_RANGE     1U  // [address:32][size:32] read-only range
+#define MEM_CACHE_CLEAR_RANGES  2U  // drop all ranges and the cached data
+#define MEM_CACHE_STATUS        3U  // -> [hits:32][misses:32]
+
+typedef uint8_t (*mem_cache_read_t)(uint32_t address, uint8_t *data, uint32_t size);
+
+extern uint8_t  mem_cache_read       (uint32_t address, uint8_t *data, uint32_t size, mem_cache_read_t read);
+extern void     mem_cache_invalidate (uint32_t address, uint32_t size);
+extern void     mem_cache_flush      (void);
+extern void     mem_cache_check_transfer (const uint8_t *request, uint32_t block);
+extern uint32_t DAP_MemoryCache      (const uint8_t *request, uint8_t *response);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef __RISCV_DMI_H__
+#define __RISCV_DMI_H__
+
+#include <stdint.h>
+
+// DMI Transfer operations
+#define DMI_TRANSFER_READ           0x00U   // [addr:8]                       -> [data:32]
+#define DMI_TRANSFER_WRITE          0x01U   // [addr:8][data:32]
+#define DMI_TRANSFER_COMMAND        0x02U   // [command:32]
+#define DMI_TRANSFER_SBA_READ       0x03U   // [address:32][words:16]          -> [data]
+#define DMI_TRANSFER_SBA_WRITE      0x04U   // [address:32][words:16][data]
+#define DMI_TRANSFER_PROGBUF_READ   0x05U   // [address:32][words:16]          -> [data]
+#define DMI_TRANSFER_PROGBUF_WRITE  0x06U   // [address:32][words:16][data]
+
+// DMI Transfer status
+#define DMI_STATUS_OK               0x00U
+#define DMI_STATUS_BUSY             0x01U   // DMI stayed busy after all retries
+#define DMI_STATUS_FAILED           0x02U   // DMI operation failed
+#define DMI_STATUS_CMDERR           0x03U   // abstract command error, detail is cmderr
+#define DMI_STATUS_SBERROR          0x04U   // system bus error, detail is sberror, bit 3 is sbbusyerror
+#define DMI_STATUS_INVALID          0xFFU   // malformed request or port is not JTAG
+
+extern uint32_t DAP_DMI_Transfer(const uint8_t *request, uint8_t *response);
+
+#endif
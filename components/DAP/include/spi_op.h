@@ -4,16 +4,23 @@
 #include <stdint.h>
 
 
-void DAP_SPI_WriteBits(const uint8_t count, const uint8_t *buf);
-void DAP_SPI_ReadBits(const uint8_t count, uint8_t *buf);
+void DAP_SPI_WriteBits(uint32_t count, const uint8_t *buf);
+void DAP_SPI_ReadBits(uint32_t count, uint8_t *buf);
 
 void DAP_SPI_Send_Header(const uint8_t packetHeaderData, uint8_t *ack, uint8_t TrnAfterACK);
 void DAP_SPI_Read_Data(uint32_t* resData, uint8_t* resParity);
 void DAP_SPI_Write_Data(uint32_t data, uint8_t parity);
+void DAP_SPI_Write_Data_Idle(uint32_t data, uint8_t parity, uint8_t idle);
+void DAP_SPI_Read_Fused(const uint8_t packetHeaderData, uint8_t *ack, uint32_t *resData, uint8_t *resParity);
+void DAP_SPI_Write_Posted_Begin(uint8_t idle);
+void DAP_SPI_Write_Posted(const uint8_t packetHeaderData, uint32_t data, uint8_t parity);
+void DAP_SPI_Write_Posted_End(void);
 
 void DAP_SPI_Generate_Cycle(uint8_t num);
 void DAP_SPI_Fast_Cycle();
 
+void DAP_SPI_JTAG_Shift(uint32_t count, const uint8_t *tdi, uint8_t *tdo);
+
 void DAP_SPI_Protocol_Error_Read();
 void DAP_SPI_Protocol_Error_Write();
 
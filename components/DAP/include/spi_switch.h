@@ -7,4 +7,7 @@ void DAP_SPI_Deinit();
 void DAP_SPI_Acquire();
 void DAP_SPI_Release();
 
+void DAP_SPI_JTAG_Init();
+void DAP_SPI_JTAG_Deinit();
+
 #endif
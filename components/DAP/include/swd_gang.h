@@ -0,0 +1,12 @@
+#ifndef __SWD_GANG_H__
+#define __SWD_GANG_H__
+
+#include <stdint.h>
+
+// Gang transfer request that is not a DAP transfer: line reset and JTAG-to-SWD switch
+#define SWD_GANG_LINE_RESET     0xFFU
+
+extern uint32_t DAP_SWD_GangTransfer   (const uint8_t *request, uint8_t *response);
+extern uint32_t DAP_SWD_GangWriteBlock (const uint8_t *request, uint8_t *response);
+
+#endif
@@ -58,18 +58,30 @@ uint8_t swd_read_word(uint32_t addr, uint32_t *val);
 uint8_t swd_write_word(uint32_t addr, uint32_t val);
 uint8_t swd_read_byte(uint32_t addr, uint8_t *val);
 uint8_t swd_write_byte(uint32_t addr, uint8_t val);
+uint8_t swd_read_halfword(uint32_t addr, uint16_t *val);
+uint8_t swd_write_halfword(uint32_t addr, uint16_t val);
 uint8_t swd_read_memory(uint32_t address, uint8_t *data, uint32_t size);
 uint8_t swd_write_memory(uint32_t address, uint8_t *data, uint32_t size);
+uint8_t swd_read_memory_width(uint32_t address, uint8_t *data, uint32_t size, uint32_t width);
+uint8_t swd_write_memory_width(uint32_t address, uint8_t *data, uint32_t size, uint32_t width);
 uint8_t swd_read_core_register(uint32_t n, uint32_t *val);
 uint8_t swd_write_core_register(uint32_t n, uint32_t val);
+uint8_t swd_read_core_registers(const uint8_t *regsel, uint32_t count, uint32_t *val);
+uint8_t swd_write_core_registers(const uint8_t *regsel, const uint32_t *val, uint32_t count);
+uint8_t swd_flash_syscall_start(const program_syscall_t *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4);
+uint8_t swd_flash_syscall_result(uint32_t *r0);
+uint8_t swd_flash_syscall_wait(uint32_t arg1, uint32_t arg2, flash_algo_return_t return_type);
 uint8_t swd_flash_syscall_exec(const program_syscall_t *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, flash_algo_return_t return_type);
 uint8_t swd_set_target_state_hw(target_state_t state);
 uint8_t swd_set_target_state_sw(target_state_t state);
 uint8_t swd_transfer_retry(uint32_t req, uint32_t *data);
 void int2array(uint8_t *res, uint32_t data, uint8_t len);
 void swd_set_reset_connect(SWD_CONNECT_TYPE type);
+void swd_invalidate_dap_state(void);
 void swd_set_soft_reset(uint32_t soft_reset_type);
 uint8_t JTAG2SWD(void);
+uint8_t DORMANT2SWD(void);
+uint8_t DORMANT2JTAG(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,19 @@
+#ifndef __TARGET_STUB_H__
+#define __TARGET_STUB_H__
+
+#include <stdint.h>
+
+// Routines that run on the target, see target_stub.c
+#define TARGET_STUB_CRC32       0U  // arg: initial CRC,     result: CRC-32 of the range
+#define TARGET_STUB_FILL        1U  // arg: byte value,      result: 0
+#define TARGET_STUB_COMPARE     2U  // arg: second address,  result: offset of the first difference
+#define TARGET_STUB_BLANK       3U  // arg: erased value,    result: offset of the first other byte
+#define TARGET_STUB_COUNT       4U
+
+// Target RAM used by a call: the code, then the stack
+#define TARGET_STUB_WORKSPACE   (168U + 64U)
+
+extern uint8_t target_stub_run(uint32_t function, uint32_t workspace, uint32_t address,
+                               uint32_t size, uint32_t arg, uint32_t *result);
+
+#endif
@@ -30,6 +30,7 @@
 #include "components/DAP/config/DAP_config.h"
 #include "components/DAP/include/DAP.h"
 #include "components/DAP/include/spi_switch.h"
+#include "components/DAP/include/mem_cache.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -226,6 +227,9 @@ static uint32_t DAP_HostStatus(const uint8_t *request, uint8_t *response) {
 static uint32_t DAP_Connect(const uint8_t *request, uint8_t *response) {
   uint32_t port;
 
+  // Possibly another target
+  mem_cache_flush();
+
   if (*request == DAP_PORT_AUTODETECT) {
     port = DAP_DEFAULT_PORT;
   } else {
@@ -236,6 +240,13 @@ static uint32_t DAP_Connect(const uint8_t *request, uint8_t *response) {
 #if (DAP_SWD != 0)
     case DAP_PORT_SWD:
       DAP_Data.debug_port = DAP_PORT_SWD;
+#if (USE_SPI_JTAG == 1) && !defined CONFIG_IDF_TARGET_ESP8266
+      if (SWD_TransferSpeed == kTransfer_JTAG_SPI) {
+        DAP_SPI_JTAG_Deinit();
+        DAP_SPI_Init();
+        SWD_TransferSpeed = kTransfer_SPI;
+      }
+#endif
       if (SWD_TransferSpeed != kTransfer_SPI)
         PORT_SWD_SETUP();
       break;
@@ -243,7 +254,17 @@ static uint32_t DAP_Connect(const uint8_t *request, uint8_t *response) {
 #if (DAP_JTAG != 0)
     case DAP_PORT_JTAG:
       DAP_Data.debug_port = DAP_PORT_JTAG;
+      DAP_Data.jtag_dev.ir_valid = 0U;
       PORT_JTAG_SETUP();
+      if ((SWD_TransferSpeed == kTransfer_SPI) || (SWD_TransferSpeed == kTransfer_JTAG_SPI)) {
+#if (USE_SPI_JTAG == 1) && !defined CONFIG_IDF_TARGET_ESP8266
+        DAP_SPI_JTAG_Init();
+        SWD_TransferSpeed = kTransfer_JTAG_SPI;
+#else
+        DAP_SPI_Deinit();
+        SWD_TransferSpeed = kTransfer_GPIO_fast;
+#endif
+      }
       break;
 #endif
     default:
@@ -273,6 +294,7 @@ static uint32_t DAP_Disconnect(uint8_t *response) {
 //   response: pointer to response data
 //   return:   number of bytes in response
 static uint32_t DAP_ResetTarget(uint8_t *response) {
+  mem_cache_flush();
 
 #if (USE_FORCE_SYSRESETREQ_AFTER_FLASH)
   if (DAP_Data.debug_port == DAP_PORT_SWD) {
@@ -290,6 +312,9 @@ static uint32_t DAP_ResetTarget(uint8_t *response) {
   }
 #endif
 
+#if (DAP_JTAG != 0)
+  DAP_Data.jtag_dev.ir_valid = 0U;
+#endif
   *(response+1) = RESET_TARGET();
   *(response+0) = DAP_OK;
   return (2U);
@@ -305,6 +330,10 @@ static uint32_t DAP_SWJ_Pins(const uint8_t *request, uint8_t *response) {
 #if ((DAP_SWD != 0) || (DAP_JTAG != 0))
   if (SWD_TransferSpeed == kTransfer_SPI)
     DAP_SPI_Deinit();
+#if (USE_SPI_JTAG == 1) && !defined CONFIG_IDF_TARGET_ESP8266
+  if (SWD_TransferSpeed == kTransfer_JTAG_SPI)
+    DAP_SPI_JTAG_Deinit();
+#endif
 
   uint32_t value;
   uint32_t select;
@@ -313,11 +342,21 @@ static uint32_t DAP_SWJ_Pins(const uint8_t *request, uint8_t *response) {
 
   value  = (uint32_t) *(request+0);
   select = (uint32_t) *(request+1);
+  if (select & (1U << DAP_SWJ_nRESET)) {
+    mem_cache_flush();
+  }
   wait   = (uint32_t)(*(request+2) <<  0) |
            (uint32_t)(*(request+3) <<  8) |
            (uint32_t)(*(request+4) << 16) |
            (uint32_t)(*(request+5) << 24);
 
+#if (DAP_JTAG != 0)
+  // Driving TCK, TMS or nTRST may move the TAP state machine
+  if ((select & ((1U << DAP_SWJ_SWCLK_TCK) | (1U << DAP_SWJ_SWDIO_TMS) | (1U << DAP_SWJ_nTRST))) != 0U) {
+    DAP_Data.jtag_dev.ir_valid = 0U;
+  }
+#endif
+
   if ((select & (1U << DAP_SWJ_SWCLK_TCK)) != 0U) {
     if ((value & (1U << DAP_SWJ_SWCLK_TCK)) != 0U) {
       PIN_SWCLK_TCK_SET();
@@ -400,6 +439,10 @@ static uint32_t DAP_SWJ_Pins(const uint8_t *request, uint8_t *response) {
 
   if (SWD_TransferSpeed == kTransfer_SPI) // restore
     DAP_SPI_Init();
+#if (USE_SPI_JTAG == 1) && !defined CONFIG_IDF_TARGET_ESP8266
+  if (SWD_TransferSpeed == kTransfer_JTAG_SPI)
+    DAP_SPI_JTAG_Init();
+#endif
 
   return ((6U << 16) | 1U);
 }
@@ -415,6 +458,7 @@ static uint32_t DAP_SWJ_Clock(const uint8_t *request, uint8_t *response) {
 #if ((DAP_SWD != 0) || (DAP_JTAG != 0))
   uint32_t clock;
   uint32_t delay;
+  uint64_t half_period;
 
   clock = (uint32_t)(*(request+0) <<  0) |
           (uint32_t)(*(request+1) <<  8) |
@@ -428,46 +472,52 @@ static uint32_t DAP_SWJ_Clock(const uint8_t *request, uint8_t *response) {
 
   // Note that the maximum IO frequency of esp8266 is less than 2MHz
 
+#if (USE_SPI_JTAG == 1) && !defined CONFIG_IDF_TARGET_ESP8266
+  // TDI is routed to SPI in JTAG mode
+  if (SWD_TransferSpeed == kTransfer_JTAG_SPI) {
+    DAP_SPI_JTAG_Deinit();
+    SWD_TransferSpeed = kTransfer_GPIO_fast;
+  }
+#endif
+
   // clock >= 10MHz -> use 40MHz SPI
   if (clock >= 10000000) {
     if (DAP_Data.debug_port != DAP_PORT_JTAG) {
       DAP_SPI_Init();
       SWD_TransferSpeed = kTransfer_SPI;
     } else {
+#if (USE_SPI_JTAG == 1) && !defined CONFIG_IDF_TARGET_ESP8266
+      DAP_SPI_JTAG_Init();
+      SWD_TransferSpeed = kTransfer_JTAG_SPI;
+#else
       SWD_TransferSpeed = kTransfer_GPIO_fast;
+#endif
     }
     DAP_Data.fast_clock  = 1U;
     DAP_Data.clock_delay = 1U;
 
-  } else if (clock >= 2000000) {
-    // clock >= 2MHz -> Use GPIO with no program delay
+  } else if (clock >= SWJ_Calibration.fast_clock) {
+    // Use GPIO with no program delay
     DAP_SPI_Deinit();
     DAP_Data.fast_clock  = 1U;
     DAP_Data.clock_delay = 1U;
     SWD_TransferSpeed = kTransfer_GPIO_fast;
   } else {
-    // clock < 2MHz -> Use GPIO with delay
+    // Use GPIO with delay, based on the calibrated cost of the delay loop
     DAP_SPI_Deinit();
     DAP_Data.fast_clock  = 0U;
     SWD_TransferSpeed = kTransfer_GPIO_normal;
 
-
-#ifdef CONFIG_IDF_TARGET_ESP8266
-  #define BUS_CLOCK_FIXED 80000000
-#elif defined CONFIG_IDF_TARGET_ESP32 || defined CONFIG_IDF_TARGET_ESP32S3
-  #define BUS_CLOCK_FIXED 100000000
-#elif defined CONFIG_IDF_TARGET_ESP32C3
-  #define BUS_CLOCK_FIXED 80000000
-#endif
-
-    delay = ((BUS_CLOCK_FIXED/2U) + (clock - 1U)) / clock;
-    if (delay > IO_PORT_WRITE_CYCLES) {
-      delay -= IO_PORT_WRITE_CYCLES;
-      delay  = (delay + (DELAY_SLOW_CYCLES - 1U)) / DELAY_SLOW_CYCLES;
+    half_period = 500000000000ULL / clock; // ps
+    if (half_period > SWJ_Calibration.overhead_ps) {
+      half_period -= SWJ_Calibration.overhead_ps;
+      delay = (uint32_t)((half_period + (SWJ_Calibration.delay_ps - 1U)) / SWJ_Calibration.delay_ps);
+      if (delay == 0U) {
+        delay = 1U;
+      }
     } else {
       delay  = 1U;
     }
-
     DAP_Data.clock_delay = delay;
   }
 
@@ -643,6 +693,7 @@ static uint32_t DAP_JTAG_Configure(const uint8_t *request, uint8_t *response) {
 
   count = *request++;
   DAP_Data.jtag_dev.count = (uint8_t)count;
+  DAP_Data.jtag_dev.ir_valid = 0U;
 
   bits = 0U;
   for (n = 0U; n < count; n++) {
@@ -1316,6 +1367,8 @@ static uint32_t DAP_Dummy_Transfer(const uint8_t *request, uint8_t *response) {
 static uint32_t DAP_Transfer(const uint8_t *request, uint8_t *response) {
   uint32_t num;
 
+  mem_cache_check_transfer(request, 0U);
+
   switch (DAP_Data.debug_port) {
 #if (DAP_SWD != 0)
     case DAP_PORT_SWD:
@@ -1400,6 +1453,17 @@ static uint32_t DAP_SWD_TransferBlock(const uint8_t *request, uint8_t *response)
       response_count++;
     }
   } else {
+#if (USE_SWD_OVERRUN_STREAM == 1)
+    // Write memory block without waiting for each ACK
+    response_value = SWD_TransferStream(request_value, request, request_count);
+    if (response_value == DAP_TRANSFER_OK) {
+      response_count = request_count;
+      goto end;
+    }
+    if (DAP_TransferAbort) {
+      goto end;     // report the abort instead of writing the block again
+    }
+#endif
     // Write register block
     while (request_count--) {
       // Load data
@@ -1556,6 +1620,8 @@ end:
 static uint32_t DAP_TransferBlock(const uint8_t *request, uint8_t *response) {
   uint32_t num;
 
+  mem_cache_check_transfer(request, 1U);
+
   switch (DAP_Data.debug_port) {
 #if (DAP_SWD != 0)
     case DAP_PORT_SWD:
@@ -1844,6 +1910,7 @@ void DAP_Setup(void) {
 #endif
 #if (DAP_JTAG != 0)
   DAP_Data.jtag_dev.count = 0U;
+  DAP_Data.jtag_dev.ir_valid = 0U;
 #endif
 
   DAP_SETUP();  // Device specific setup
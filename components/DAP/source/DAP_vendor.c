@@ -25,8 +25,16 @@
  *
  *---------------------------------------------------------------------------*/
 
+#include <string.h>
+
 #include "components/DAP/config/DAP_config.h"
 #include "components/DAP/include/DAP.h"
+#include "components/DAP/include/dap_utility.h"
+#include "components/DAP/include/swd_host.h"
+#include "components/DAP/include/riscv_dmi.h"
+#include "components/DAP/include/swd_gang.h"
+#include "components/DAP/include/target_stub.h"
+#include "components/DAP/include/mem_cache.h"
 #include "components/elaphureLink/elaphureLink_protocol.h"
 
 //**************************************************************************************************
@@ -40,6 +48,727 @@ Vendor Commands. Copy this file to the project folder of the Debug Unit and add
 file to the MDK-ARM project under the file group Configuration.
 */
 
+// Access width of the memory commands
+#define DAP_MEMORY_WIDTH_AUTO   0U      // bytes up to alignment, then words
+#define DAP_MEMORY_WIDTH_8      1U
+#define DAP_MEMORY_WIDTH_16     2U
+#define DAP_MEMORY_WIDTH_32     4U
+
+// Core Registers command
+#define DAP_CORE_READ           0U
+#define DAP_CORE_WRITE          1U
+#define DAP_CORE_SNAPSHOT       2U      // registers and stack, only when the core is halted
+#define DAP_CORE_REG_MAX        64U
+#define DAP_CORE_DHCSR          0xE000EDF0U
+#define DAP_CORE_SP             13U
+
+// AP state the host may have cached, restored after a memory command
+typedef struct {
+  uint32_t select;
+  uint32_t csw;
+  uint32_t tar;
+  uint8_t  select_valid;
+} DAP_MemoryState_t;
+
+// Save the AP state and start a memory command
+//   state:  AP state
+//   return: 1 on success, 0 otherwise
+static uint8_t DAP_MemoryBegin(DAP_MemoryState_t *state) {
+  state->select_valid = SWD_GetSelect(&state->select);
+  swd_invalidate_dap_state();
+
+  if (!swd_read_ap(AP_CSW, &state->csw)) {
+    return 0U;
+  }
+  if (!swd_read_ap(AP_TAR, &state->tar)) {
+    return 0U;
+  }
+  return 1U;
+}
+
+// Restore the AP state after a memory command
+//   state:  AP state
+//   ok:     result of the memory command
+//   return: none
+static void DAP_MemoryEnd(const DAP_MemoryState_t *state, uint8_t ok) {
+  if (!ok) {
+    swd_clear_errors();
+  }
+  swd_write_ap(AP_CSW, state->csw);
+  swd_write_ap(AP_TAR, state->tar);
+  if (state->select_valid) {
+    swd_write_dp(DP_SELECT, state->select);
+  }
+}
+
+// Access target memory with a fixed access width
+//   address: byte address
+//   data:    pointer to data
+//   size:    number of bytes
+//   width:   access width
+//   write:   0 = read, 1 = write
+//   return:  1 on success, 0 otherwise
+static uint8_t DAP_MemoryAccess(uint32_t address, uint8_t *data, uint32_t size, uint32_t width, uint32_t write) {
+  switch (width) {
+    case DAP_MEMORY_WIDTH_AUTO:
+      break;
+    case DAP_MEMORY_WIDTH_8:
+    case DAP_MEMORY_WIDTH_16:
+      // Runs with address auto-increment, packed where the MEM-AP supports it
+      return write ? swd_write_memory_width(address, data, size, width) :
+                     swd_read_memory_width(address, data, size, width);
+    case DAP_MEMORY_WIDTH_32:
+      // Aligned, so only word blocks are used
+      if ((address | size) & 3U) {
+        return 0U;
+      }
+      break;
+    default:
+      return 0U;
+  }
+
+  return write ? swd_write_memory(address, data, size) : swd_read_memory(address, data, size);
+}
+
+// Process Memory Read command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+static uint32_t DAP_MemoryRead(const uint8_t *request, uint8_t *response) {
+  DAP_MemoryState_t state;
+  uint32_t width;
+  uint32_t address;
+  uint32_t size;
+  uint8_t  ok;
+
+  width   = request[0];
+  address = (uint32_t)(request[1] <<  0) |
+            (uint32_t)(request[2] <<  8) |
+            (uint32_t)(request[3] << 16) |
+            (uint32_t)(request[4] << 24);
+  size    = (uint32_t)(request[5] <<  0) |
+            (uint32_t)(request[6] <<  8);
+
+  if ((DAP_Data.debug_port != DAP_PORT_SWD) || (size > (DAP_PACKET_SIZE - 2U))) {
+    *response = DAP_ERROR;
+    return ((7U << 16) | 1U);
+  }
+
+  ok = DAP_MemoryBegin(&state);
+  if (ok) {
+    ok = DAP_MemoryAccess(address, response + 1, size, width, 0U);
+  }
+  DAP_MemoryEnd(&state, ok);
+
+  if (!ok) {
+    *response = DAP_ERROR;
+    return ((7U << 16) | 1U);
+  }
+
+  *response = DAP_OK;
+  return ((7U << 16) | (1U + size));
+}
+
+// Process Memory Write command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+static uint32_t DAP_MemoryWrite(const uint8_t *request, uint8_t *response) {
+  DAP_MemoryState_t state;
+  uint32_t width;
+  uint32_t address;
+  uint32_t size;
+  uint8_t  ok;
+
+  width   = request[0];
+  address = (uint32_t)(request[1] <<  0) |
+            (uint32_t)(request[2] <<  8) |
+            (uint32_t)(request[3] << 16) |
+            (uint32_t)(request[4] << 24);
+  size    = (uint32_t)(request[5] <<  0) |
+            (uint32_t)(request[6] <<  8);
+
+  if ((DAP_Data.debug_port != DAP_PORT_SWD) || (size > (DAP_PACKET_SIZE - 8U))) {
+    *response = DAP_ERROR;
+    return ((7U << 16) | 1U);
+  }
+
+  ok = DAP_MemoryBegin(&state);
+  if (ok) {
+    ok = DAP_MemoryAccess(address, (uint8_t *)(request + 7), size, width, 1U);
+  }
+  DAP_MemoryEnd(&state, ok);
+
+  *response = ok ? DAP_OK : DAP_ERROR;
+  return (((7U + size) << 16) | 1U);
+}
+
+// Process Memory CRC command and prepare response
+//   Ranges are read on the probe, only the CRC-32 of each range goes back to the host.
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+static uint32_t DAP_MemoryCRC(const uint8_t *request, uint8_t *response) {
+  static uint8_t buffer[256];
+  DAP_MemoryState_t state;
+  uint32_t count;
+  uint32_t address;
+  uint32_t size;
+  uint32_t chunk;
+  uint32_t crc;
+  uint32_t n;
+  uint8_t  ok;
+
+  count = request[0];
+  if ((DAP_Data.debug_port != DAP_PORT_SWD) || (count > ((DAP_PACKET_SIZE - 2U) / 8U))) {
+    *response = DAP_ERROR;
+    return (((1U + count * 8U) << 16) | 1U);
+  }
+
+  ok = DAP_MemoryBegin(&state);
+  for (n = 0U; ok && (n < count); n++) {
+    address = (uint32_t)(request[1U + n * 8U] <<  0) |
+              (uint32_t)(request[2U + n * 8U] <<  8) |
+              (uint32_t)(request[3U + n * 8U] << 16) |
+              (uint32_t)(request[4U + n * 8U] << 24);
+    size    = (uint32_t)(request[5U + n * 8U] <<  0) |
+              (uint32_t)(request[6U + n * 8U] <<  8) |
+              (uint32_t)(request[7U + n * 8U] << 16) |
+              (uint32_t)(request[8U + n * 8U] << 24);
+
+    crc = 0U;
+    for (; ok && size; size -= chunk, address += chunk) {
+      chunk = (size < sizeof(buffer)) ? size : sizeof(buffer);
+      ok = swd_read_memory(address, buffer, chunk);
+      crc = Crc32(crc, buffer, chunk);
+    }
+    response[1U + n * 4U] = (uint8_t)(crc >>  0);
+    response[2U + n * 4U] = (uint8_t)(crc >>  8);
+    response[3U + n * 4U] = (uint8_t)(crc >> 16);
+    response[4U + n * 4U] = (uint8_t)(crc >> 24);
+  }
+  DAP_MemoryEnd(&state, ok);
+
+  if (!ok) {
+    *response = DAP_ERROR;
+    return (((1U + count * 8U) << 16) | 1U);
+  }
+
+  *response = DAP_OK;
+  return (((1U + count * 8U) << 16) | (1U + count * 4U));
+}
+
+
+// Process Target Stub command and prepare response
+//   A built-in routine runs on the halted target, only its result goes back to the host.
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+static uint32_t DAP_TargetStub(const uint8_t *request, uint8_t *response) {
+  DAP_MemoryState_t state;
+  uint32_t function;
+  uint32_t workspace;
+  uint32_t address;
+  uint32_t size;
+  uint32_t arg;
+  uint32_t result;
+  uint8_t  ok;
+
+  function  = request[0];
+  workspace = (uint32_t)(request[1]  <<  0) |
+              (uint32_t)(request[2]  <<  8) |
+              (uint32_t)(request[3]  << 16) |
+              (uint32_t)(request[4]  << 24);
+  address   = (uint32_t)(request[5]  <<  0) |
+              (uint32_t)(request[6]  <<  8) |
+              (uint32_t)(request[7]  << 16) |
+              (uint32_t)(request[8]  << 24);
+  size      = (uint32_t)(request[9]  <<  0) |
+              (uint32_t)(request[10] <<  8) |
+              (uint32_t)(request[11] << 16) |
+              (uint32_t)(request[12] << 24);
+  arg       = (uint32_t)(request[13] <<  0) |
+              (uint32_t)(request[14] <<  8) |
+              (uint32_t)(request[15] << 16) |
+              (uint32_t)(request[16] << 24);
+
+  if (DAP_Data.debug_port != DAP_PORT_SWD) {
+    *response = DAP_ERROR;
+    return ((17U << 16) | 1U);
+  }
+
+  ok = DAP_MemoryBegin(&state);
+  if (ok) {
+    ok = target_stub_run(function, workspace, address, size, arg, &result);
+  }
+  DAP_MemoryEnd(&state, ok);
+
+  if (!ok) {
+    *response = DAP_ERROR;
+    return ((17U << 16) | 1U);
+  }
+
+  response[0] = DAP_OK;
+  response[1] = (uint8_t)(result >>  0);
+  response[2] = (uint8_t)(result >>  8);
+  response[3] = (uint8_t)(result >> 16);
+  response[4] = (uint8_t)(result >> 24);
+  return ((17U << 16) | 5U);
+}
+
+// Process Core Registers command and prepare response
+//   Register numbers are DCRSR REGSEL values: R0-R15, xPSR, MSP, PSP, CONTROL, FP registers.
+//   The whole set is pipelined through the banked data registers of the MEM-AP.
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+static uint32_t DAP_CoreRegisters(const uint8_t *request, uint8_t *response) {
+  static uint8_t  regsel[DAP_CORE_REG_MAX + 1U];
+  static uint32_t val[DAP_CORE_REG_MAX + 1U];
+  DAP_MemoryState_t state;
+  const uint8_t *data;
+  uint8_t  *values;
+  uint32_t request_len;
+  uint32_t response_len;
+  uint32_t mode;
+  uint32_t count;
+  uint32_t stack;
+  uint32_t dhcsr;
+  uint32_t n;
+  uint8_t  ok;
+
+  mode  = request[0];
+  count = request[1];
+  stack = 0U;
+
+  switch (mode) {
+    case DAP_CORE_READ:
+      request_len  = 2U + count;
+      response_len = 1U + count * 4U;
+      data = request + 2;
+      break;
+    case DAP_CORE_WRITE:
+      request_len  = 2U + count * 5U;
+      response_len = 1U;
+      data = request + 2;
+      break;
+    case DAP_CORE_SNAPSHOT:
+      stack = (uint32_t)(request[2] <<  0) |
+              (uint32_t)(request[3] <<  8);
+      request_len  = 4U + count;
+      response_len = 2U + count * 4U + stack;
+      data = request + 4;
+      break;
+    default:
+      *response = DAP_ERROR;
+      return ((2U << 16) | 1U);
+  }
+
+  if ((DAP_Data.debug_port != DAP_PORT_SWD) || (count > DAP_CORE_REG_MAX) ||
+      (request_len > DAP_PACKET_SIZE - 1U) || (response_len > DAP_PACKET_SIZE - 1U)) {
+    *response = DAP_ERROR;
+    return ((request_len << 16) | 1U);
+  }
+
+  for (n = 0U; n < count; n++) {
+    if (mode == DAP_CORE_WRITE) {
+      regsel[n] = data[n * 5U];
+      val[n]    = (uint32_t)(data[n * 5U + 1U] <<  0) |
+                  (uint32_t)(data[n * 5U + 2U] <<  8) |
+                  (uint32_t)(data[n * 5U + 3U] << 16) |
+                  (uint32_t)(data[n * 5U + 4U] << 24);
+    } else {
+      regsel[n] = data[n];
+    }
+  }
+
+  // Values follow the status, and the halted flag for a snapshot
+  values = response + ((mode == DAP_CORE_SNAPSHOT) ? 2U : 1U);
+
+  ok = DAP_MemoryBegin(&state);
+
+  if (mode == DAP_CORE_SNAPSHOT) {
+    // Nothing but the halt state while the core runs, the host simply polls
+    if (ok) {
+      ok = swd_read_word(DAP_CORE_DHCSR, &dhcsr);
+    }
+    if (ok && !(dhcsr & S_HALT)) {
+      DAP_MemoryEnd(&state, ok);
+      response[0] = DAP_OK;
+      response[1] = 0U;
+      return ((request_len << 16) | 2U);
+    }
+    // SP comes last, for the stack read
+    regsel[count] = DAP_CORE_SP;
+    if (ok) {
+      ok = swd_read_core_registers(regsel, count + 1U, val);
+    }
+    if (ok && stack) {
+      ok = swd_read_memory(val[count], values + count * 4U, stack);
+    }
+    response[1] = 1U;
+  } else if (ok) {
+    ok = (mode == DAP_CORE_WRITE) ? swd_write_core_registers(regsel, val, count) :
+                                    swd_read_core_registers(regsel, count, val);
+  }
+
+  DAP_MemoryEnd(&state, ok);
+
+  if (!ok) {
+    *response = DAP_ERROR;
+    return ((request_len << 16) | 1U);
+  }
+
+  if (mode != DAP_CORE_WRITE) {
+    for (n = 0U; n < count; n++) {
+      values[n * 4U + 0U] = (uint8_t)(val[n] >>  0);
+      values[n * 4U + 1U] = (uint8_t)(val[n] >>  8);
+      values[n * 4U + 2U] = (uint8_t)(val[n] >> 16);
+      values[n * 4U + 3U] = (uint8_t)(val[n] >> 24);
+    }
+  }
+
+  *response = DAP_OK;
+  return ((request_len << 16) | response_len);
+}
+
+// Multi-drop targets remembered by DAP_SWD_SelectTarget
+#define DAP_TARGET_CACHE_SIZE   4U
+
+typedef struct {
+  uint32_t targetsel;
+  uint32_t select;
+  uint32_t stamp;           // last use, for LRU replacement
+  uint8_t  select_valid;
+  uint8_t  powered;         // debug and system power-up acknowledged
+} DAP_TargetState_t;
+
+static DAP_TargetState_t DAP_TargetCache[DAP_TARGET_CACHE_SIZE];
+static uint32_t DAP_TargetStamp;
+static DAP_TargetState_t *DAP_TargetCurrent;
+
+// Look up a target in the cache, or replace the least recently used entry
+//   targetsel: TARGETSEL value
+//   hit:       1 if the target was found
+//   return:    cache entry
+static DAP_TargetState_t *DAP_TargetLookup(uint32_t targetsel, uint8_t *hit) {
+  DAP_TargetState_t *entry;
+  DAP_TargetState_t *lru;
+  uint32_t n;
+
+  lru = &DAP_TargetCache[0];
+  for (n = 0U; n < DAP_TARGET_CACHE_SIZE; n++) {
+    entry = &DAP_TargetCache[n];
+    if ((entry->stamp != 0U) && (entry->targetsel == targetsel)) {
+      *hit = 1U;
+      return entry;
+    }
+    if (entry->stamp < lru->stamp) {
+      lru = entry;
+    }
+  }
+
+  *hit = 0U;
+  lru->targetsel    = targetsel;
+  lru->select_valid = 0U;
+  lru->powered      = 0U;
+  return lru;
+}
+
+// Power up the debug and system domains of the selected target
+//   return: 1 on success, 0 otherwise
+static uint8_t DAP_TargetPowerUp(void) {
+  uint32_t val;
+  uint32_t n;
+
+  val = STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR;
+  if (SWD_Transfer(DP_ABORT, &val) != DAP_TRANSFER_OK) {
+    return 0U;
+  }
+  val = CSYSPWRUPREQ | CDBGPWRUPREQ;
+  if (SWD_Transfer(DP_CTRL_STAT, &val) != DAP_TRANSFER_OK) {
+    return 0U;
+  }
+  for (n = 0U; n < 100U; n++) {
+    if (SWD_Transfer(DP_CTRL_STAT | DAP_TRANSFER_RnW, &val) != DAP_TRANSFER_OK) {
+      return 0U;
+    }
+    if ((val & (CSYSPWRUPACK | CDBGPWRUPACK)) == (CSYSPWRUPACK | CDBGPWRUPACK)) {
+      return 1U;
+    }
+  }
+  return 0U;
+}
+
+// Process SWD Select Target command and prepare response
+//   Switching to a cached target costs a line reset, TARGETSEL, the mandatory DPIDR read
+//   and restoring DP SELECT. Unknown targets are powered up first.
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+static uint32_t DAP_SWD_SelectTarget(const uint8_t *request, uint8_t *response) {
+  static const uint8_t line_reset[8] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 };
+  DAP_TargetState_t *entry;
+  uint32_t targetsel;
+  uint32_t dpidr;
+  uint32_t val;
+  uint8_t  hit;
+
+  targetsel = (uint32_t)(request[0] <<  0) |
+              (uint32_t)(request[1] <<  8) |
+              (uint32_t)(request[2] << 16) |
+              (uint32_t)(request[3] << 24);
+
+  if (DAP_Data.debug_port != DAP_PORT_SWD) {
+    *response = DAP_ERROR;
+    return ((4U << 16) | 1U);
+  }
+
+  // Remember where the current target was left
+  if ((DAP_TargetCurrent != NULL) && SWD_GetTargetSel(&val) && (val == DAP_TargetCurrent->targetsel)) {
+    DAP_TargetCurrent->select_valid = SWD_GetSelect(&DAP_TargetCurrent->select);
+  }
+  DAP_TargetCurrent = NULL;
+
+  SWJ_Sequence(64U, line_reset);
+  SWD_WriteTargetSel(targetsel);
+  if (SWD_Transfer(DP_IDCODE | DAP_TRANSFER_RnW, &dpidr) != DAP_TRANSFER_OK) {
+    *response = DAP_ERROR;
+    return ((4U << 16) | 1U);
+  }
+
+  entry = DAP_TargetLookup(targetsel, &hit);
+  if (!entry->powered) {
+    hit = 0U;
+    entry->powered = DAP_TargetPowerUp();
+    if (!entry->powered) {
+      *response = DAP_ERROR;
+      return ((4U << 16) | 1U);
+    }
+  }
+  if (entry->select_valid) {
+    val = entry->select;
+    SWD_Transfer(DP_SELECT, &val);
+  }
+  entry->stamp = ++DAP_TargetStamp;
+  DAP_TargetCurrent = entry;
+
+  // swd_host caches belong to the previous target
+  swd_invalidate_dap_state();
+  mem_cache_flush();
+
+  response[0] = DAP_OK;
+  response[1] = (uint8_t)(dpidr >>  0);
+  response[2] = (uint8_t)(dpidr >>  8);
+  response[3] = (uint8_t)(dpidr >> 16);
+  response[4] = (uint8_t)(dpidr >> 24);
+  response[5] = hit;
+  return ((4U << 16) | 6U);
+}
+
+
+#if (DAP_JTAG != 0)
+
+// JTAG chain scan limits
+#define JTAG_SCAN_IR_MAX        256U    // maximum total IR length
+#define JTAG_SCAN_DR_BITS       ((DAP_JTAG_DEV_CNT + 1U) * 32U)
+
+// JTAG chain scan status
+#define JTAG_SCAN_OK            0x00U
+#define JTAG_SCAN_NO_CHAIN      0x01U   // no device found or TDO stuck
+#define JTAG_SCAN_TOO_MANY      0x02U   // more devices than DAP_JTAG_DEV_CNT
+#define JTAG_SCAN_IR_UNKNOWN    0x03U   // IR lengths could not be split between devices
+#define JTAG_SCAN_BYPASS        0x04U   // BYPASS length differs from the device count
+
+// Clock TCK cycles with a constant TMS level and TDI high
+static void JTAG_ScanTMS(uint32_t tms, uint32_t count) {
+  static const uint8_t ones[8] = {0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU};
+
+  JTAG_Sequence((count & JTAG_SEQUENCE_TCK) | (tms ? JTAG_SEQUENCE_TMS : 0U), ones, NULL);
+}
+
+// Shift a constant TDI level through the current Shift-xR state and capture TDO
+//   tdi:    TDI level
+//   count:  number of bits, a multiple of 64
+//   tdo:    captured bits, LSB first
+//   exit:   clock the last bit with TMS high
+static void JTAG_ScanShift(uint32_t tdi, uint32_t count, uint8_t *tdo, uint32_t exit) {
+  static const uint8_t zeros[8];
+  static const uint8_t ones[8] = {0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU};
+  const uint8_t *data = tdi ? ones : zeros;
+  uint8_t last;
+
+  for (; count > 64U; count -= 64U, tdo += 8U) {
+    JTAG_Sequence(JTAG_SEQUENCE_TDO, data, tdo);                        // 64 bits
+  }
+  JTAG_Sequence(63U | JTAG_SEQUENCE_TDO, data, tdo);
+  JTAG_Sequence(1U | JTAG_SEQUENCE_TDO | (exit ? JTAG_SEQUENCE_TMS : 0U), data, &last);
+  tdo[7] = (uint8_t)((tdo[7] & 0x7FU) | ((last & 1U) << 7));
+}
+
+static uint32_t JTAG_ScanBit(const uint8_t *buf, uint32_t n) {
+  return (buf[n / 8U] >> (n % 8U)) & 1U;
+}
+
+// Find the first high bit
+//   return: bit position, or count if there is none
+static uint32_t JTAG_ScanFirstOne(const uint8_t *buf, uint32_t count) {
+  uint32_t n;
+
+  for (n = 0U; n < count; n++) {
+    if (JTAG_ScanBit(buf, n)) {
+      break;
+    }
+  }
+  return n;
+}
+
+// Process JTAG Chain Scan command and prepare response
+//   request:  [flags] bit 0: apply the result to the JTAG device configuration
+//   response: [status][count][ir_total:16][bypass] followed by [idcode:32][ir_length] per device
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+static uint32_t DAP_JTAG_Scan(const uint8_t *request, uint8_t *response) {
+  static uint8_t dr[JTAG_SCAN_DR_BITS / 8U];
+  static uint8_t ir[2U * JTAG_SCAN_IR_MAX / 8U];
+  uint32_t idcode[DAP_JTAG_DEV_CNT];
+  uint8_t  ir_length[DAP_JTAG_DEV_CNT];
+  uint32_t count, ir_total, bypass, start, status;
+  uint32_t n, k, bits;
+  uint8_t  *p;
+
+  if (DAP_Data.debug_port != DAP_PORT_JTAG) {
+    response[0] = DAP_ERROR;
+    return ((1U << 16) | 1U);
+  }
+
+  status = JTAG_SCAN_OK;
+
+  // Test-Logic-Reset loads IDCODE (or BYPASS) into every DR, then shift them out
+  JTAG_ScanTMS(1U, 5U);                     // Test-Logic-Reset
+  JTAG_ScanTMS(0U, 1U);                     // Idle
+  JTAG_ScanTMS(1U, 1U);                     // Select-DR-Scan
+  JTAG_ScanTMS(0U, 2U);                     // Capture-DR, Shift-DR
+  JTAG_ScanShift(1U, JTAG_SCAN_DR_BITS, dr, 1U);
+  JTAG_ScanTMS(1U, 1U);                     // Update-DR
+  JTAG_ScanTMS(0U, 1U);                     // Idle
+
+  count = 0U;
+  for (n = 0U; n + 32U <= JTAG_SCAN_DR_BITS; ) {
+    if (JTAG_ScanBit(dr, n) == 0U) {
+      k = 0U;                               // BYPASS after reset
+      n += 1U;
+    } else {
+      for (k = 0U, bits = 0U; bits < 32U; bits++) {
+        k |= JTAG_ScanBit(dr, n + bits) << bits;
+      }
+      if (k == 0xFFFFFFFFU) {
+        break;                              // TDI ones, end of chain
+      }
+      n += 32U;
+    }
+    if (count == DAP_JTAG_DEV_CNT) {
+      status = JTAG_SCAN_TOO_MANY;
+      break;
+    }
+    idcode[count++] = k;
+  }
+  if ((status == JTAG_SCAN_OK) && (count == 0U)) {
+    status = JTAG_SCAN_NO_CHAIN;
+  }
+
+  // Capture the IR pattern, flush the chain with zeros, then count the ones until the first returns.
+  // The chain ends up with all ones, i.e. BYPASS in every device.
+  JTAG_ScanTMS(1U, 2U);                     // Select-DR-Scan, Select-IR-Scan
+  JTAG_ScanTMS(0U, 2U);                     // Capture-IR, Shift-IR
+  JTAG_ScanShift(0U, JTAG_SCAN_IR_MAX, ir, 0U);
+  JTAG_ScanShift(1U, JTAG_SCAN_IR_MAX, ir + JTAG_SCAN_IR_MAX / 8U, 1U);
+  JTAG_ScanTMS(1U, 1U);                     // Update-IR
+  JTAG_ScanTMS(0U, 1U);                     // Idle
+  ir_total = JTAG_ScanFirstOne(ir + JTAG_SCAN_IR_MAX / 8U, JTAG_SCAN_IR_MAX);
+
+  // Every device in BYPASS adds one DR bit
+  JTAG_ScanTMS(1U, 1U);                     // Select-DR-Scan
+  JTAG_ScanTMS(0U, 2U);                     // Capture-DR, Shift-DR
+  JTAG_ScanShift(0U, 64U, dr, 0U);
+  JTAG_ScanShift(1U, 64U, dr, 1U);
+  JTAG_ScanTMS(1U, 1U);                     // Update-DR
+  JTAG_ScanTMS(0U, 1U);                     // Idle
+  bypass = JTAG_ScanFirstOne(dr, 64U);
+
+  // Each captured IR starts with 01b (LSB first), the device next to TDO comes first
+  memset(ir_length, 0, sizeof(ir_length));
+  if (status == JTAG_SCAN_OK) {
+    if ((ir_total < 2U * count) || (ir_total >= JTAG_SCAN_IR_MAX)) {
+      status = JTAG_SCAN_NO_CHAIN;
+    } else if (count == 1U) {
+      ir_length[0] = (uint8_t)ir_total;
+    } else {
+      start = 0U;
+      k = 0U;
+      for (n = 1U; n < ir_total; n++) {
+        if ((n + 1U == ir_total) || (JTAG_ScanBit(ir, n + 1U) && !JTAG_ScanBit(ir, n + 2U))) {
+          // candidate boundary after bit n
+          if (k == count) {
+            break;
+          }
+          ir_length[k++] = (uint8_t)(n + 1U - start);
+          start = n + 1U;
+          n++;
+        }
+      }
+      if ((k != count) || (start != ir_total) || !JTAG_ScanBit(ir, 0U) || JTAG_ScanBit(ir, 1U)) {
+        memset(ir_length, 0, sizeof(ir_length));
+        status = JTAG_SCAN_IR_UNKNOWN;
+      }
+    }
+  }
+  if ((status == JTAG_SCAN_OK) && (bypass != count)) {
+    status = JTAG_SCAN_BYPASS;
+  }
+
+  if ((status == JTAG_SCAN_OK) && (*request & 0x01U)) {
+    DAP_Data.jtag_dev.count = (uint8_t)count;
+    bits = 0U;
+    for (n = 0U; n < count; n++) {
+      DAP_Data.jtag_dev.ir_length[n] = ir_length[n];
+      DAP_Data.jtag_dev.ir_before[n] = (uint16_t)bits;
+      bits += ir_length[n];
+    }
+    for (n = 0U; n < count; n++) {
+      bits -= ir_length[n];
+      DAP_Data.jtag_dev.ir_after[n] = (uint16_t)bits;
+    }
+    DAP_Data.jtag_dev.index = 0U;
+  }
+  DAP_Data.jtag_dev.ir_valid = 0U;
+
+  p = response;
+  *p++ = (uint8_t)status;
+  *p++ = (uint8_t)count;
+  *p++ = (uint8_t)(ir_total >> 0);
+  *p++ = (uint8_t)(ir_total >> 8);
+  *p++ = (uint8_t)bypass;
+  for (n = 0U; n < count; n++) {
+    *p++ = (uint8_t)(idcode[n] >>  0);
+    *p++ = (uint8_t)(idcode[n] >>  8);
+    *p++ = (uint8_t)(idcode[n] >> 16);
+    *p++ = (uint8_t)(idcode[n] >> 24);
+    *p++ = ir_length[n];
+  }
+
+  return ((1U << 16) | (uint32_t)(p - response));
+}
+
+#endif
+
+
 /** Process DAP Vendor Command and prepare Response Data
 \param request   pointer to request data
 \param response  pointer to response data
@@ -53,28 +782,82 @@ uint32_t DAP_ProcessVendorCommand(const uint8_t *request, uint8_t *response) {
 
   switch (*request++) {          // first byte in request is Command ID
     case ID_DAP_Vendor0:
-#if 0                            // example user command
-      num += 1U << 16;           // increment request count
-      if (*request == 1U) {      // when first command data byte is 1
-        *response++ = 'X';       // send 'X' as response
-        num++;                   // increment response count
-      }
+      // Memory Read:  [width][address:32][size:16]
+      //    response:  [status][data]
+      num += DAP_MemoryRead(request, response);
+      break;
+
+    case ID_DAP_Vendor1:
+      // Memory Write: [width][address:32][size:16][data]
+      //    response:  [status]
+      num += DAP_MemoryWrite(request, response);
+      break;
+
+    case ID_DAP_Vendor2:
+      // DMI Transfer: [index][count][op...]
+      //    response:  [done][status][detail][data]
+      num += DAP_DMI_Transfer(request, response);
+      break;
+
+    case ID_DAP_Vendor3:
+#if (DAP_JTAG != 0)
+      // JTAG Chain Scan: [flags]
+      //    response:  [status][count][ir_total:16][bypass][idcode:32, ir_length]...
+      num += DAP_JTAG_Scan(request, response);
+#else
+      *response = DAP_ERROR;
+      num += (1U << 16) | 1U;
 #endif
       break;
 
-    case ID_DAP_Vendor1:  break;
-    case ID_DAP_Vendor2:  break;
-    case ID_DAP_Vendor3:  break;
-    case ID_DAP_Vendor4:  break;
-    case ID_DAP_Vendor5:  break;
-    case ID_DAP_Vendor6:  break;
-    case ID_DAP_Vendor7:  break;
+    case ID_DAP_Vendor4:
+      // SWD Select Target: [targetsel:32]
+      //    response:  [status][dpidr:32][cached]
+      num += DAP_SWD_SelectTarget(request, response);
+      break;
+
+    case ID_DAP_Vendor5:
+      // Memory CRC: [count][address:32, size:32]...
+      //    response:  [status][crc:32]...
+      num += DAP_MemoryCRC(request, response);
+      break;
+
+    case ID_DAP_Vendor6:
+      // Target Stub: [function][workspace:32][address:32][size:32][arg:32]
+      //    response:  [status][result:32]
+      num += DAP_TargetStub(request, response);
+      break;
+
+    case ID_DAP_Vendor7:
+      // Core Registers: [mode][count][regsel]... (read)
+      //                 [mode][count][regsel, value:32]... (write)
+      //                 [mode][count][stack:16][regsel]... (snapshot)
+      //    response:  [status][value:32]... / [status] / [status][halted][value:32]...[stack]
+      num += DAP_CoreRegisters(request, response);
+      break;
+
     case ID_DAP_Vendor8:
       num = el_vendor_command(request, response);
       break;
-    case ID_DAP_Vendor9:  break;
-    case ID_DAP_Vendor10: break;
-    case ID_DAP_Vendor11: break;
+    case ID_DAP_Vendor9:
+      // Memory Cache: [op][address:32, size:32 for a new range]
+      //    response:  [status][hits:32, misses:32 for the status]
+      num += DAP_MemoryCache(request, response);
+      break;
+
+
+    case ID_DAP_Vendor10:
+      // SWD Gang Transfer: [buses][count][request(, data:32)]...
+      //    response:  [ok mask][ack per bus][data:32 per bus]...
+      num += DAP_SWD_GangTransfer(request, response);
+      break;
+
+    case ID_DAP_Vendor11:
+      // SWD Gang Write Block: [buses][address:32][count:16][data:32]...
+      //    response:  [ok mask][ack per bus]
+      num += DAP_SWD_GangWriteBlock(request, response);
+      break;
+
     case ID_DAP_Vendor12: break;
     case ID_DAP_Vendor13: break;
     case ID_DAP_Vendor14: break;
@@ -27,6 +27,7 @@
 
 #include "components/DAP/config/DAP_config.h"
 #include "components/DAP/include/DAP.h"
+#include "components/DAP/include/spi_op.h"
 
 
 // JTAG Macros
@@ -69,6 +70,10 @@
 
 #if (DAP_JTAG != 0)
 
+#if (USE_SPI_JTAG == 1) && !defined CONFIG_IDF_TARGET_ESP8266
+#define JTAG_USE_SPI() (SWD_TransferSpeed == kTransfer_JTAG_SPI)
+#endif
+
 
 // Generate JTAG Sequence
 //   info:   sequence information
@@ -81,11 +86,26 @@ void JTAG_Sequence (uint32_t info, const uint8_t *tdi, uint8_t *tdo) {
   uint32_t bit;
   uint32_t n, k;
 
+  // Raw sequences may leave any instruction in the TAPs
+  DAP_Data.jtag_dev.ir_valid = 0U;
+
   n = info & JTAG_SEQUENCE_TCK;
   if (n == 0U) {
     n = 64U;
   }
 
+#if (USE_SPI_JTAG == 1) && !defined CONFIG_IDF_TARGET_ESP8266
+  if (JTAG_USE_SPI()) {
+    if (info & JTAG_SEQUENCE_TMS) {
+      PIN_TMS_SET();
+    } else {
+      PIN_TMS_CLR();
+    }
+    DAP_SPI_JTAG_Shift(n, tdi, (info & JTAG_SEQUENCE_TDO) ? tdo : NULL);
+    return;
+  }
+#endif
+
   if (info & JTAG_SEQUENCE_TMS) {
     PIN_TMS_SET();
   } else {
@@ -251,15 +271,236 @@ exit:
 }
 
 
+// JTAG Data Register scan of the selected device
+//   count:  number of DR bits (1..64)
+//   tdi:    DR bits to write, LSB first
+//   idle:   number of idle cycles after the scan
+//   return: DR bits read, LSB first
+#define JTAG_DR_Function(speed) /**/                                            \
+static uint64_t JTAG_DR_##speed (uint32_t count, uint64_t tdi, uint32_t idle) { \
+  uint64_t tdo;                                                                 \
+  uint32_t bit;                                                                 \
+  uint32_t n;                                                                   \
+                                                                                \
+  PIN_TMS_SET();                                                                \
+  JTAG_CYCLE_TCK();                         /* Select-DR-Scan */                \
+  PIN_TMS_CLR();                                                                \
+  JTAG_CYCLE_TCK();                         /* Capture-DR */                    \
+  JTAG_CYCLE_TCK();                         /* Shift-DR */                      \
+                                                                                \
+  PIN_TDI_OUT(1U);                                                              \
+  for (n = DAP_Data.jtag_dev.index; n; n--) {                                   \
+    JTAG_CYCLE_TCK();                       /* Bypass before data */            \
+  }                                                                             \
+                                                                                \
+  tdo = 0U;                                                                     \
+  for (n = 0U; n < count - 1U; n++) {                                           \
+    JTAG_CYCLE_TDIO((uint32_t)(tdi >> n), bit); /* Shift DR bits (except last) */ \
+    tdo |= (uint64_t)bit << n;                                                  \
+  }                                                                             \
+  n = DAP_Data.jtag_dev.count - DAP_Data.jtag_dev.index - 1U;                   \
+  if (n) {                                                                      \
+    JTAG_CYCLE_TDIO((uint32_t)(tdi >> (count - 1U)), bit); /* Shift last DR bit */ \
+    tdo |= (uint64_t)bit << (count - 1U);                                       \
+    PIN_TDI_OUT(1U);                                                            \
+    for (--n; n; n--) {                                                         \
+      JTAG_CYCLE_TCK();                     /* Bypass after data */             \
+    }                                                                           \
+    PIN_TMS_SET();                                                              \
+    JTAG_CYCLE_TCK();                       /* Bypass & Exit1-DR */             \
+  } else {                                                                      \
+    PIN_TMS_SET();                                                              \
+    JTAG_CYCLE_TDIO((uint32_t)(tdi >> (count - 1U)), bit); /* Shift last DR bit & Exit1-DR */ \
+    tdo |= (uint64_t)bit << (count - 1U);                                       \
+  }                                                                             \
+                                                                                \
+  JTAG_CYCLE_TCK();                         /* Update-DR */                     \
+  PIN_TMS_CLR();                                                                \
+  JTAG_CYCLE_TCK();                         /* Idle */                          \
+  PIN_TDI_OUT(1U);                                                              \
+                                                                                \
+  while (idle--) {                                                              \
+    JTAG_CYCLE_TCK();                       /* Idle */                          \
+  }                                                                             \
+                                                                                \
+  return tdo;                                                                   \
+}
+
+
 #undef  PIN_DELAY
 #define PIN_DELAY() PIN_DELAY_FAST()
 JTAG_IR_Function(Fast)
 JTAG_TransferFunction(Fast)
+JTAG_DR_Function(Fast)
 
 #undef  PIN_DELAY
 #define PIN_DELAY() PIN_DELAY_SLOW(DAP_Data.clock_delay)
 JTAG_IR_Function(Slow)
 JTAG_TransferFunction(Slow)
+JTAG_DR_Function(Slow)
+
+
+#if (USE_SPI_JTAG == 1) && !defined CONFIG_IDF_TARGET_ESP8266
+
+// Shift TCK cycles with a constant TMS level over SPI
+//   tms:    TMS level
+//   n:      number of cycles, TDI is 0 after the first 64 cycles
+//   tdi:    TDI bits, LSB first
+//   return: TDO bits of the first 64 cycles, LSB first
+static uint64_t JTAG_Shift_SPI (uint32_t tms, uint32_t n, uint64_t tdi) {
+  static const uint8_t zero[32];
+  uint64_t tdo = 0U;
+
+  if (tms) {
+    PIN_TMS_SET();
+  } else {
+    PIN_TMS_CLR();
+  }
+  if (n > 64U) {
+    DAP_SPI_JTAG_Shift(64U, (const uint8_t *)&tdi, (uint8_t *)&tdo);
+    DAP_SPI_JTAG_Shift(n - 64U, zero, NULL);
+  } else {
+    DAP_SPI_JTAG_Shift(n, (const uint8_t *)&tdi, (uint8_t *)&tdo);
+  }
+  return tdo;
+}
+
+// Shift TCK cycles with a constant TMS level and TDI high over SPI
+//   tms:    TMS level
+//   n:      number of cycles
+//   return: none
+static void JTAG_Cycles_SPI (uint32_t tms, uint32_t n) {
+  if (n == 0U) {
+    return;
+  }
+  if (tms) {
+    PIN_TMS_SET();
+  } else {
+    PIN_TMS_CLR();
+  }
+  DAP_SPI_JTAG_Shift(n, NULL, NULL);
+}
+
+// Enter Shift-DR, shift the bypass before data and the request bits
+//   request: A[3:2] RnW APnDP
+//   return:  ACK[2:0]
+static uint32_t JTAG_DR_Request_SPI (uint32_t request) {
+  uint64_t tdo;
+  uint32_t n;
+
+  JTAG_Cycles_SPI(1U, 1U);                  /* Select-DR-Scan */
+
+  /* Capture-DR, Shift-DR, Bypass before data, RnW/A2/A3 */
+  n = 2U + DAP_Data.jtag_dev.index;
+  tdo = JTAG_Shift_SPI(0U, n + 3U, ((uint64_t)((request >> 1) & 7U) << n) | ((1ULL << n) - 1U));
+  tdo >>= n;
+
+  return (uint32_t)(((tdo & 1U) << 1) | ((tdo >> 1) & 1U) | (tdo & 4U));
+}
+
+// Shift the data and the bypass after data, then Exit1-DR, Update-DR and Idle
+//   val:    data to write
+//   return: data read
+static uint32_t JTAG_DR_Data_SPI (uint32_t val) {
+  uint64_t tdo;
+  uint32_t n;
+
+  n = DAP_Data.jtag_dev.count - DAP_Data.jtag_dev.index - 1U;
+  if (n) {
+    tdo = JTAG_Shift_SPI(0U, 32U + n - 1U, (~0ULL << 32) | val);   /* D0..D31, Bypass after data */
+    JTAG_Cycles_SPI(1U, 2U);                                      /* Bypass & Exit1-DR, Update-DR */
+  } else {
+    tdo  = JTAG_Shift_SPI(0U, 31U, val);                          /* D0..D30 */
+    tdo |= (JTAG_Shift_SPI(1U, 2U, (val >> 31) | 2U) & 1U) << 31; /* D31 & Exit1-DR, Update-DR */
+  }
+  JTAG_Cycles_SPI(0U, 1U);                  /* Idle */
+
+  return (uint32_t)tdo;
+}
+
+// JTAG Set IR over SPI
+//   ir:     IR value
+//   return: none
+static void JTAG_IR_SPI (uint32_t ir) {
+  uint32_t n;
+
+  JTAG_Cycles_SPI(1U, 2U);                  /* Select-DR-Scan, Select-IR-Scan */
+  JTAG_Cycles_SPI(0U, 2U + DAP_Data.jtag_dev.ir_before[DAP_Data.jtag_dev.index]); /* Capture-IR, Shift-IR, Bypass before data */
+
+  n = DAP_Data.jtag_dev.ir_length[DAP_Data.jtag_dev.index];
+  if (DAP_Data.jtag_dev.ir_after[DAP_Data.jtag_dev.index]) {
+    JTAG_Shift_SPI(0U, n, ir);              /* Set IR bits */
+    JTAG_Cycles_SPI(0U, DAP_Data.jtag_dev.ir_after[DAP_Data.jtag_dev.index] - 1U); /* Bypass after data */
+    JTAG_Cycles_SPI(1U, 2U);                /* Bypass & Exit1-IR, Update-IR */
+  } else {
+    if (n > 1U) {
+      JTAG_Shift_SPI(0U, n - 1U, ir);       /* Set IR bits (except last) */
+    }
+    JTAG_Shift_SPI(1U, 2U, ((n > 32U) ? 0U : ((ir >> (n - 1U)) & 1U)) | 2U); /* Set last IR bit & Exit1-IR, Update-IR */
+  }
+  JTAG_Cycles_SPI(0U, 1U);                  /* Idle */
+}
+
+// JTAG Transfer I/O over SPI
+//   request: A[3:2] RnW APnDP
+//   data:    DATA[31:0]
+//   return:  ACK[2:0]
+static uint8_t JTAG_Transfer_SPI (uint32_t request, uint32_t *data) {
+  uint32_t ack;
+  uint32_t val;
+
+  ack = JTAG_DR_Request_SPI(request);
+  if (ack != DAP_TRANSFER_OK) {
+    /* Exit on error */
+    JTAG_Cycles_SPI(1U, 2U);                /* Exit1-DR, Update-DR */
+    JTAG_Cycles_SPI(0U, 1U);                /* Idle */
+  } else if (request & DAP_TRANSFER_RnW) {
+    /* Read Transfer */
+    val = JTAG_DR_Data_SPI(0U);
+    if (data) { *data = val; }
+  } else {
+    /* Write Transfer */
+    JTAG_DR_Data_SPI(*data);
+  }
+
+  /* Capture Timestamp */
+  if (request & DAP_TRANSFER_TIMESTAMP) {
+    DAP_Data.timestamp = TIMESTAMP_GET();
+  }
+
+  /* Idle cycles */
+  JTAG_Cycles_SPI(0U, DAP_Data.transfer.idle_cycles);
+
+  return ((uint8_t)ack);
+}
+
+// JTAG Data Register scan of the selected device over SPI
+//   count:  number of DR bits (1..64)
+//   tdi:    DR bits to write, LSB first
+//   idle:   number of idle cycles after the scan
+//   return: DR bits read, LSB first
+static uint64_t JTAG_DR_SPI (uint32_t count, uint64_t tdi, uint32_t idle) {
+  uint64_t tdo;
+  uint32_t n;
+
+  JTAG_Cycles_SPI(1U, 1U);                  /* Select-DR-Scan */
+  JTAG_Cycles_SPI(0U, 2U + DAP_Data.jtag_dev.index); /* Capture-DR, Shift-DR, Bypass before data */
+
+  n = DAP_Data.jtag_dev.count - DAP_Data.jtag_dev.index - 1U;
+  if (n) {
+    tdo = JTAG_Shift_SPI(0U, count, tdi);   /* DR bits */
+    JTAG_Cycles_SPI(0U, n - 1U);            /* Bypass after data */
+    JTAG_Cycles_SPI(1U, 2U);                /* Bypass & Exit1-DR, Update-DR */
+  } else {
+    tdo = (count > 1U) ? JTAG_Shift_SPI(0U, count - 1U, tdi) : 0U; /* DR bits (except last) */
+    tdo |= (JTAG_Shift_SPI(1U, 2U, ((tdi >> (count - 1U)) & 1U) | 2U) & 1U) << (count - 1U); /* Last DR bit & Exit1-DR, Update-DR */
+  }
+  JTAG_Cycles_SPI(0U, 1U + idle);           /* Idle */
+
+  return tdo;
+}
+
+#endif
 
 
 // JTAG Read IDCODE register
@@ -269,6 +510,19 @@ uint32_t JTAG_ReadIDCode (void) {
   uint32_t val;
   uint32_t n;
 
+#if (USE_SPI_JTAG == 1) && !defined CONFIG_IDF_TARGET_ESP8266
+  if (JTAG_USE_SPI()) {
+    uint64_t tdo;
+
+    JTAG_Cycles_SPI(1U, 1U);                /* Select-DR-Scan */
+    n = 2U + DAP_Data.jtag_dev.index;       /* Capture-DR, Shift-DR, Bypass before data */
+    tdo = JTAG_Shift_SPI(0U, n + 31U, ~0ULL) >> n;              /* D0..D30 */
+    tdo |= (JTAG_Shift_SPI(1U, 2U, ~0ULL) & 1U) << 31;          /* D31 & Exit1-DR, Update-DR */
+    JTAG_Cycles_SPI(0U, 1U);                /* Idle */
+    return (uint32_t)tdo;
+  }
+#endif
+
   PIN_TMS_SET();
   JTAG_CYCLE_TCK();                         /* Select-DR-Scan */
   PIN_TMS_CLR();
@@ -303,6 +557,14 @@ uint32_t JTAG_ReadIDCode (void) {
 void JTAG_WriteAbort (uint32_t data) {
   uint32_t n;
 
+#if (USE_SPI_JTAG == 1) && !defined CONFIG_IDF_TARGET_ESP8266
+  if (JTAG_USE_SPI()) {
+    JTAG_DR_Request_SPI(0U);                /* RnW=0, A2=0, A3=0 */
+    JTAG_DR_Data_SPI(data);
+    return;
+  }
+#endif
+
   PIN_TMS_SET();
   JTAG_CYCLE_TCK();                         /* Select-DR-Scan */
   PIN_TMS_CLR();
@@ -346,11 +608,30 @@ void JTAG_WriteAbort (uint32_t data) {
 //   ir:     IR value
 //   return: none
 void JTAG_IR (uint32_t ir) {
+  uint32_t n;
+
+  // Skip the scan if the device already holds this instruction
+  if (DAP_Data.jtag_dev.ir_valid && (DAP_Data.jtag_dev.ir_cache[DAP_Data.jtag_dev.index] == ir)) {
+    return;
+  }
+
+#if (USE_SPI_JTAG == 1) && !defined CONFIG_IDF_TARGET_ESP8266
+  if (JTAG_USE_SPI()) {
+    JTAG_IR_SPI(ir);
+  } else
+#endif
   if (DAP_Data.fast_clock) {
     JTAG_IR_Fast(ir);
   } else {
     JTAG_IR_Slow(ir);
   }
+
+  // All other devices are in BYPASS now
+  for (n = 0U; n < DAP_Data.jtag_dev.count; n++) {
+    DAP_Data.jtag_dev.ir_cache[n] = 0xFFFFFFFFU;
+  }
+  DAP_Data.jtag_dev.ir_cache[DAP_Data.jtag_dev.index] = ir;
+  DAP_Data.jtag_dev.ir_valid = 1U;
 }
 
 
@@ -359,6 +640,11 @@ void JTAG_IR (uint32_t ir) {
 //   data:    DATA[31:0]
 //   return:  ACK[2:0]
 uint8_t  JTAG_Transfer(uint32_t request, uint32_t *data) {
+#if (USE_SPI_JTAG == 1) && !defined CONFIG_IDF_TARGET_ESP8266
+  if (JTAG_USE_SPI()) {
+    return JTAG_Transfer_SPI(request, data);
+  }
+#endif
   if (DAP_Data.fast_clock) {
     return JTAG_TransferFast(request, data);
   } else {
@@ -367,4 +653,30 @@ uint8_t  JTAG_Transfer(uint32_t request, uint32_t *data) {
 }
 
 
+// JTAG Data Register scan of the selected device
+//   count:  number of DR bits (1..64)
+//   tdi:    DR bits to write, LSB first
+//   idle:   number of idle cycles after the scan
+//   return: DR bits read, LSB first
+uint64_t JTAG_DR (uint32_t count, uint64_t tdi, uint32_t idle) {
+  uint64_t tdo;
+
+#if (USE_SPI_JTAG == 1) && !defined CONFIG_IDF_TARGET_ESP8266
+  if (JTAG_USE_SPI()) {
+    tdo = JTAG_DR_SPI(count, tdi, idle);
+  } else
+#endif
+  if (DAP_Data.fast_clock) {
+    tdo = JTAG_DR_Fast(count, tdi, idle);
+  } else {
+    tdo = JTAG_DR_Slow(count, tdi, idle);
+  }
+
+  if (count < 64U) {
+    tdo &= (1ULL << count) - 1U;
+  }
+  return tdo;
+}
+
+
 #endif  /* (DAP_JTAG != 0) */
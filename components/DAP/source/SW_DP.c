@@ -32,6 +32,11 @@
  * @change:
  *    2021-2-10 Support GPIO and SPI for SWD sequence / SWJ sequence / SWD transfer
  *              Note: SWD sequence not yet tested
+ *    2026-10-19 Stamp out the GPIO engines per clock tier, calibrate the delay loop
+ *    2026-10-19 Data phase on WAIT/FAULT for SPI, streaming writes with overrun detection
+ *    2026-10-19 Fused single transaction SPI transfers
+ *    2026-10-19 Pipelined stream writes, used by swd_host block writes
+ *    2026-10-19 SWJ sequence in SPI JTAG mode
  * @version 0.1
  * @date 2021-2-10
  *
@@ -43,6 +48,7 @@
 
 #include "components/DAP/config/DAP_config.h"
 #include "components/DAP/include/DAP.h"
+#include "components/DAP/include/debug_cm.h"
 #include "components/DAP/include/spi_op.h"
 #include "components/DAP/include/spi_switch.h"
 #include "components/DAP/include/dap_utility.h"
@@ -65,43 +71,64 @@
 
 // SW Macros
 
-#define PIN_DELAY() PIN_DELAY_SLOW(DAP_Data.clock_delay)
-
 #define PIN_SWCLK_SET PIN_SWCLK_TCK_SET
 #define PIN_SWCLK_CLR PIN_SWCLK_TCK_CLR
 
-// Space for time in the original version,
-// and time for space in our implementation
-
-#define SW_CLOCK_CYCLE()                     \
-  PIN_SWCLK_CLR();                           \
-  if (unlikely(need_delay)) { PIN_DELAY(); } \
-  else { PIN_DELAY_FAST(); }                 \
-  PIN_SWCLK_SET();                           \
-  if (unlikely(need_delay)) { PIN_DELAY(); }
-
-#define SW_WRITE_BIT(bit)                    \
-  PIN_SWDIO_OUT(bit);                        \
-  PIN_SWCLK_CLR();                           \
-  if (unlikely(need_delay)) { PIN_DELAY(); } \
-  PIN_SWCLK_SET();                           \
-  if (unlikely(need_delay)) { PIN_DELAY(); }
-
-#define SW_READ_BIT(bit)                     \
-  PIN_SWCLK_CLR();                           \
-  if (unlikely(need_delay)) { PIN_DELAY(); } \
-  else { PIN_DELAY_FAST(); }                 \
-  bit = PIN_SWDIO_IN();                      \
-  PIN_SWCLK_SET();                           \
-  if (unlikely(need_delay)) { PIN_DELAY(); }
+// The GPIO bit engines are stamped out once per clock tier (see the
+// *_Function macros below), so the inner loops do not test the tier per bit.
+//   PIN_DELAY_LOW():   delay after the falling edge (clock and read bits)
+//   PIN_DELAY_WRITE(): delay after the falling edge (write bits)
+//   PIN_DELAY_HIGH():  delay after the rising edge
+
+#define SW_CLOCK_CYCLE()                \
+  PIN_SWCLK_CLR();                      \
+  PIN_DELAY_LOW();                      \
+  PIN_SWCLK_SET();                      \
+  PIN_DELAY_HIGH()
+
+#define SW_WRITE_BIT(bit)               \
+  PIN_SWDIO_OUT(bit);                   \
+  PIN_SWCLK_CLR();                      \
+  PIN_DELAY_WRITE();                    \
+  PIN_SWCLK_SET();                      \
+  PIN_DELAY_HIGH()
+
+#define SW_READ_BIT(bit)                \
+  PIN_SWCLK_CLR();                      \
+  PIN_DELAY_LOW();                      \
+  bit = PIN_SWDIO_IN();                 \
+  PIN_SWCLK_SET();                      \
+  PIN_DELAY_HIGH()
+
+// Same timing as SW_CLOCK_CYCLE(), but SWCLK is left high
+#define SW_CALIBRATION_CYCLE()          \
+  PIN_SWCLK_SET();                      \
+  PIN_DELAY_LOW();                      \
+  PIN_SWCLK_SET();                      \
+  PIN_DELAY_HIGH()
 
 uint8_t SWD_TransferSpeed = kTransfer_GPIO_normal;
 
-void SWJ_Sequence_GPIO (uint32_t count, const uint8_t *data, uint8_t need_delay);
+// Last value written to DP SELECT, only valid after a successful write.
+// A line reset (SWJ sequence) may be the start of a new connection.
+static uint32_t SWD_Select;
+static uint8_t  SWD_SelectValid;
+
+// Last value written to DP TARGETSEL with SWD_WriteTargetSel(), cleared by a line reset from the host
+static uint32_t SWD_TargetSel;
+static uint8_t  SWD_TargetSelValid;
+
+#if ((DAP_SWD != 0) || (DAP_JTAG != 0))
+static void SWJ_Sequence_Fast (uint32_t count, const uint8_t *data);
+static void SWJ_Sequence_Slow (uint32_t count, const uint8_t *data);
 void SWJ_Sequence_SPI (uint32_t count, const uint8_t *data);
+#endif
 
-void SWD_Sequence_GPIO (uint32_t info, const uint8_t *swdo, uint8_t *swdi);
+#if (DAP_SWD != 0)
+static void SWD_Sequence_Fast (uint32_t info, const uint8_t *swdo, uint8_t *swdi);
+static void SWD_Sequence_Slow (uint32_t info, const uint8_t *swdo, uint8_t *swdi);
 void SWD_Sequence_SPI (uint32_t info, const uint8_t *swdo, uint8_t *swdi);
+#endif
 
 // Generate SWJ Sequence
 //   count:  sequence bit count
@@ -115,34 +142,56 @@ void SWJ_Sequence (uint32_t count, const uint8_t *data) {
   //   return;
   // }
 
-  if(SWD_TransferSpeed == kTransfer_SPI) {
-    SWJ_Sequence_SPI(count, data);
-  } else {
-    SWJ_Sequence_GPIO(count, data, 1);
-  }
+  SWD_SelectValid = 0U;
+  SWD_TargetSelValid = 0U;
+#if (DAP_JTAG != 0)
+  // May be a TAP reset
+  DAP_Data.jtag_dev.ir_valid = 0U;
+#endif
 
+  switch (SWD_TransferSpeed) {
+    case kTransfer_SPI:
+      SWJ_Sequence_SPI(count, data);
+      break;
+#if (USE_SPI_JTAG == 1) && !defined CONFIG_IDF_TARGET_ESP8266
+    case kTransfer_JTAG_SPI:
+      // TMS changes on every bit, borrow TCK for GPIO
+      PIN_SWCLK_TCK_SET();
+      DAP_SPI_Release();
+      SWJ_Sequence_Fast(count, data);
+      DAP_SPI_Acquire();
+      break;
+#endif
+    case kTransfer_GPIO_fast:
+      SWJ_Sequence_Fast(count, data);
+      break;
+    default:
+      SWJ_Sequence_Slow(count, data);
+      break;
+  }
 }
 
-void IRAM_ATTR SWJ_Sequence_GPIO (uint32_t count, const uint8_t *data, uint8_t need_delay) {
-    uint32_t val;
-    uint32_t n;
-
-    val = 0U;
-    n = 0U;
-    while (count--) {
-      if (n == 0U) {
-        val = *data++;
-        n = 8U;
-      }
-      if (val & 1U) {
-        PIN_SWDIO_TMS_SET();
-      } else {
-        PIN_SWDIO_TMS_CLR();
-      }
-      SW_CLOCK_CYCLE();
-      val >>= 1;
-      n--;
-    }
+#define SWJ_SequenceFunction(speed) /**/                                        \
+static void IRAM_ATTR SWJ_Sequence_##speed (uint32_t count, const uint8_t *data) { \
+  uint32_t val;                                                                 \
+  uint32_t n;                                                                   \
+                                                                                \
+  val = 0U;                                                                     \
+  n = 0U;                                                                       \
+  while (count--) {                                                             \
+    if (n == 0U) {                                                              \
+      val = *data++;                                                            \
+      n = 8U;                                                                   \
+    }                                                                           \
+    if (val & 1U) {                                                             \
+      PIN_SWDIO_TMS_SET();                                                      \
+    } else {                                                                    \
+      PIN_SWDIO_TMS_CLR();                                                      \
+    }                                                                           \
+    SW_CLOCK_CYCLE();                                                           \
+    val >>= 1;                                                                  \
+    n--;                                                                        \
+  }                                                                             \
 }
 
 void SWJ_Sequence_SPI (uint32_t count, const uint8_t *data) {
@@ -157,47 +206,52 @@ void SWJ_Sequence_SPI (uint32_t count, const uint8_t *data) {
 //   return: none
 #if (DAP_SWD != 0)
 void SWD_Sequence (uint32_t info, const uint8_t *swdo, uint8_t *swdi) {
-  if (SWD_TransferSpeed == kTransfer_SPI) {
-    SWD_Sequence_SPI(info, swdo, swdi);
-  } else {
-    SWD_Sequence_GPIO(info, swdo, swdi);
+  switch (SWD_TransferSpeed) {
+    case kTransfer_SPI:
+      SWD_Sequence_SPI(info, swdo, swdi);
+      break;
+    case kTransfer_GPIO_fast:
+      SWD_Sequence_Fast(info, swdo, swdi);
+      break;
+    default:
+      SWD_Sequence_Slow(info, swdo, swdi);
+      break;
   }
 }
 
-void IRAM_ATTR SWD_Sequence_GPIO (uint32_t info, const uint8_t *swdo, uint8_t *swdi) {
-  const uint8_t need_delay = 1;
-
-  uint32_t val;
-  uint32_t bit;
-  uint32_t n, k;
-
-  n = info & SWD_SEQUENCE_CLK;
-  if (n == 0U) {
-    n = 64U;
-  }
-  // n = 1 ~ 64
-
-  // LSB
-  if (info & SWD_SEQUENCE_DIN) {
-    while (n) {
-      val = 0U;
-      for (k = 8U; k && n; k--, n--) {
-        SW_READ_BIT(bit);
-        val >>= 1;
-        val  |= bit << 7;
-      }
-      val >>= k;
-      *swdi++ = (uint8_t)val;
-    }
-  } else {
-    while (n) {
-      val = *swdo++;
-      for (k = 8U; k && n; k--, n--) {
-        SW_WRITE_BIT(val);
-        val >>= 1;
-      }
-    }
-  }
+#define SWD_SequenceFunction(speed) /**/                                        \
+static void IRAM_ATTR SWD_Sequence_##speed (uint32_t info, const uint8_t *swdo, uint8_t *swdi) { \
+  uint32_t val;                                                                 \
+  uint32_t bit;                                                                 \
+  uint32_t n, k;                                                                \
+                                                                                \
+  n = info & SWD_SEQUENCE_CLK;                                                  \
+  if (n == 0U) {                                                                \
+    n = 64U;                                                                    \
+  }                                                                             \
+  /* n = 1 ~ 64 */                                                              \
+                                                                                \
+  /* LSB */                                                                     \
+  if (info & SWD_SEQUENCE_DIN) {                                                \
+    while (n) {                                                                 \
+      val = 0U;                                                                 \
+      for (k = 8U; k && n; k--, n--) {                                          \
+        SW_READ_BIT(bit);                                                       \
+        val >>= 1;                                                              \
+        val  |= bit << 7;                                                       \
+      }                                                                         \
+      val >>= k;                                                                \
+      *swdi++ = (uint8_t)val;                                                   \
+    }                                                                           \
+  } else {                                                                      \
+    while (n) {                                                                 \
+      val = *swdo++;                                                            \
+      for (k = 8U; k && n; k--, n--) {                                          \
+        SW_WRITE_BIT(val);                                                      \
+        val >>= 1;                                                              \
+      }                                                                         \
+    }                                                                           \
+  }                                                                             \
 }
 
 void SWD_Sequence_SPI (uint32_t info, const uint8_t *swdo, uint8_t *swdi) {
@@ -223,7 +277,6 @@ void SWD_Sequence_SPI (uint32_t info, const uint8_t *swdo, uint8_t *swdi) {
 //   data:    DATA[31:0]
 //   return:  ACK[2:0]
 static uint8_t SWD_Transfer_SPI (uint32_t request, uint32_t *data) {
-  //// FIXME: overrun detection
   // SPI transfer mode does not require operations such as PIN_DELAY
   uint8_t ack;
   // uint32_t bit;
@@ -305,11 +358,16 @@ static uint8_t SWD_Transfer_SPI (uint32_t request, uint32_t *data) {
 
     }
     else if ((ack == DAP_TRANSFER_WAIT) || (ack == DAP_TRANSFER_FAULT)) {
+      if (DAP_Data.swd_conf.data_phase) {
+        /* Dummy read: 32bits data + 1bit parity + 1bit Trn */
+        DAP_SPI_Read_Data(&val, &parity);
+      } else {
 #if defined CONFIG_IDF_TARGET_ESP8266 || defined CONFIG_IDF_TARGET_ESP32
-      DAP_SPI_Generate_Cycle(1);
+        DAP_SPI_Generate_Cycle(1);
 #elif defined CONFIG_IDF_TARGET_ESP32C3 || defined CONFIG_IDF_TARGET_ESP32S3
-      DAP_SPI_Fast_Cycle();
+        DAP_SPI_Fast_Cycle();
 #endif
+      }
 
 #if (PRINT_SWD_PROTOCOL == 1)
       os_printf("WAIT\r\n");
@@ -336,6 +394,14 @@ static uint8_t SWD_Transfer_SPI (uint32_t request, uint32_t *data) {
     parity = ParityEvenUint32(*data);
     DAP_SPI_Send_Header(requestByte, &ack, 1); // 1 Trn After ACK
     if (ack == DAP_TRANSFER_OK) {
+#if (USE_SPI_FUSED_TRANSFER == 1)
+      if ((request & DAP_TRANSFER_TIMESTAMP) == 0U) {
+        /* Data and idle cycles */
+        DAP_SPI_Write_Data_Idle(*data, parity, DAP_Data.transfer.idle_cycles);
+        PIN_SWDIO_TMS_SET();
+        return ((uint8_t)ack);
+      }
+#endif
       DAP_SPI_Write_Data(*data, parity);
       /* Capture Timestamp */
       if (request & DAP_TRANSFER_TIMESTAMP) {
@@ -351,8 +417,11 @@ static uint8_t SWD_Transfer_SPI (uint32_t request, uint32_t *data) {
     }
     else if ((ack == DAP_TRANSFER_WAIT) || (ack == DAP_TRANSFER_FAULT)) {
       /* already turnaround. */
-
-      /* TODO: overrun transfer -> for read */
+      if (DAP_Data.swd_conf.data_phase) {
+        /* Dummy write: 32bits data + 1bit parity */
+        DAP_SPI_Write_Data(0U, 0U);
+        PIN_SWDIO_TMS_SET();
+      }
 #if (PRINT_SWD_PROTOCOL == 1)
       os_printf("WAIT\r\n");
 #endif
@@ -378,147 +447,577 @@ static uint8_t SWD_Transfer_SPI (uint32_t request, uint32_t *data) {
   return DAP_TRANSFER_ERROR;
 }
 
-static uint8_t IRAM_ATTR SWD_Transfer_GPIO (uint32_t request, uint32_t *data, uint8_t need_delay) {
-  uint32_t ack;
-  uint32_t bit;
+
+#if (USE_SPI_FUSED_TRANSFER == 1)
+
+// Number of reads done in split mode after a fused read went wrong
+#define SWD_FUSED_BACKOFF  16U
+
+static uint8_t SWD_FusedBackoff;
+
+// Bring the DP back after a fused read was not answered with OK
+static void SWD_Transfer_SPI_Recover (void) {
+  static const uint8_t line_reset[8] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 };
   uint32_t val;
-  uint32_t parity;
 
-  uint32_t n;
+  PIN_SWDIO_TMS_SET();
+  SWJ_Sequence_SPI(64U, line_reset);
+  if (SWD_TargetSelValid) {
+    SWD_WriteTargetSel(SWD_TargetSel);     // multi-drop targets are deselected by the line reset
+  }
+  SWD_Transfer_SPI(DP_IDCODE | DAP_TRANSFER_RnW, &val);
+  if (SWD_SelectValid) {
+    val = SWD_Select;
+    SWD_Transfer_SPI(DP_SELECT, &val);
+  }
+}
 
-  /* Packet Request */
-  parity = 0U;
-  SW_WRITE_BIT(1U);                     /* Start Bit */
-  bit = request >> 0;
-  SW_WRITE_BIT(bit);                    /* APnDP Bit */
-  parity += bit;
-  bit = request >> 1;
-  SW_WRITE_BIT(bit);                    /* RnW Bit */
-  parity += bit;
-  bit = request >> 2;
-  SW_WRITE_BIT(bit);                    /* A2 Bit */
-  parity += bit;
-  bit = request >> 3;
-  SW_WRITE_BIT(bit);                    /* A3 Bit */
-  parity += bit;
-  SW_WRITE_BIT(parity);                 /* Parity Bit */
-  SW_WRITE_BIT(0U);                     /* Stop Bit */
-  SW_WRITE_BIT(1U);                     /* Park Bit */
-
-  /* Turnaround */
-  PIN_SWDIO_OUT_DISABLE();
-  for (n = DAP_Data.swd_conf.turnaround; n; n--) {
-    SW_CLOCK_CYCLE();
+// SWD Transfer I/O, reads are done in a single SPI transaction when data_phase is set
+//   request: A[3:2] RnW APnDP
+//   data:    DATA[31:0]
+//   return:  ACK[2:0]
+static uint8_t SWD_Transfer_SPI_Fused (uint32_t request, uint32_t *data) {
+  uint8_t ack;
+  uint32_t val;
+  uint8_t parity;
+
+  const uint8_t constantBits = 0b10000001U; /* Start Bit  & Stop Bit & Park Bit is fixed. */
+  uint8_t requestByte;  /* LSB */
+
+  /* Without a data phase on WAIT/FAULT a fused read would clock one the target does not expect */
+  if (((request & DAP_TRANSFER_RnW) == 0U) || !DAP_Data.swd_conf.data_phase || SWD_FusedBackoff) {
+    if ((request & DAP_TRANSFER_RnW) && SWD_FusedBackoff) {
+      SWD_FusedBackoff--;
+    }
+    return SWD_Transfer_SPI(request, data);
   }
 
-  /* Acknowledge response */
-  SW_READ_BIT(bit);
-  ack  = bit << 0;
-  SW_READ_BIT(bit);
-  ack |= bit << 1;
-  SW_READ_BIT(bit);
-  ack |= bit << 2;
-
-  if (ack == DAP_TRANSFER_OK) {         /* OK response */
-    /* Data transfer */
-    if (request & DAP_TRANSFER_RnW) {
-      /* Read data */
-      val = 0U;
-      parity = 0U;
-      UNROLL_32({
-        SW_READ_BIT(bit);               /* Read RDATA[0:31] */
-        parity += bit;
-        val >>= 1;
-        val  |= bit << 31;
-      })
-      SW_READ_BIT(bit);                 /* Read Parity */
-      if ((parity ^ bit) & 1U) {
-        ack = DAP_TRANSFER_ERROR;
-      }
-      if (data) { *data = val; }
-      /* Turnaround */
-      for (n = DAP_Data.swd_conf.turnaround; n; n--) {
-        SW_CLOCK_CYCLE();
-      }
-      PIN_SWDIO_OUT_ENABLE();
-    } else {
-      /* Turnaround */
-      for (n = DAP_Data.swd_conf.turnaround; n; n--) {
-        SW_CLOCK_CYCLE();
-      }
-      PIN_SWDIO_OUT_ENABLE();
-      /* Write data */
-      val = *data;
-      parity = 0U;
-      UNROLL_32({
-        SW_WRITE_BIT(val);              /* Write WDATA[0:31] */
-        parity += val;
-        val >>= 1;
-      })
-      SW_WRITE_BIT(parity);             /* Write Parity Bit */
+  requestByte = constantBits | (((uint8_t)(request & 0xFU)) << 1U) | (ParityEvenUint8(request & 0xFU) << 5U);
+
+  DAP_SPI_Read_Fused(requestByte, &ack, &val, &parity);
+  if (ack == DAP_TRANSFER_OK) {
+    if ((ParityEvenUint32(val) ^ parity) & 1U) {
+      ack = DAP_TRANSFER_ERROR;
     }
+    if (data) { *data = val; }
+
     /* Capture Timestamp */
     if (request & DAP_TRANSFER_TIMESTAMP) {
       DAP_Data.timestamp = TIMESTAMP_GET();
     }
-    /* Idle cycles */
-    n = DAP_Data.transfer.idle_cycles;
-    if (n) {
-      PIN_SWDIO_OUT(0U);
-      for (; n; n--) {
-        SW_CLOCK_CYCLE();
-      }
-    }
-    PIN_SWDIO_OUT(1U);
     return ((uint8_t)ack);
   }
 
   if ((ack == DAP_TRANSFER_WAIT) || (ack == DAP_TRANSFER_FAULT)) {
-    /* WAIT or FAULT response */
-    if (DAP_Data.swd_conf.data_phase && ((request & DAP_TRANSFER_RnW) != 0U)) {
-      for (n = 32U+1U; n; n--) {
-        SW_CLOCK_CYCLE();               /* Dummy Read RDATA[0:31] + Parity */
-      }
-    }
-    /* Turnaround */
-    for (n = DAP_Data.swd_conf.turnaround; n; n--) {
-      SW_CLOCK_CYCLE();
-    }
-    PIN_SWDIO_OUT_ENABLE();
-    if (DAP_Data.swd_conf.data_phase && ((request & DAP_TRANSFER_RnW) == 0U)) {
-      PIN_SWDIO_OUT(0U);
-      for (n = 32U+1U; n; n--) {
-        SW_CLOCK_CYCLE();               /* Dummy Write WDATA[0:31] + Parity */
-      }
-    }
-    PIN_SWDIO_OUT(1U);
+    /* The data phase the target expected has already been clocked */
     return ((uint8_t)ack);
   }
 
-  /* Protocol error */
-  for (n = DAP_Data.swd_conf.turnaround + 32U + 1U; n; n--) {
-    SW_CLOCK_CYCLE();                   /* Back off data phase */
-  }
-  PIN_SWDIO_OUT_ENABLE();
-  PIN_SWDIO_OUT(1U);
-  return ((uint8_t)ack);
+  /* No valid ACK: the data phase was clocked while the target was not expecting it */
+  SWD_Transfer_SPI_Recover();
+  SWD_FusedBackoff = SWD_FUSED_BACKOFF;
+
+  return SWD_Transfer_SPI(request, data);
 }
 
+#endif // (USE_SPI_FUSED_TRANSFER == 1)
+
+// SWD Transfer I/O (GPIO)
+//   request: A[3:2] RnW APnDP
+//   data:    DATA[31:0]
+//   return:  ACK[2:0]
+#define SWD_TransferFunction(speed) /**/                                        \
+static uint8_t IRAM_ATTR SWD_Transfer_##speed (uint32_t request, uint32_t *data) { \
+  uint32_t ack;                                                                 \
+  uint32_t bit;                                                                 \
+  uint32_t val;                                                                 \
+  uint32_t parity;                                                              \
+                                                                                \
+  uint32_t n;                                                                   \
+                                                                                \
+  /* Packet Request */                                                          \
+  parity = 0U;                                                                  \
+  SW_WRITE_BIT(1U);                     /* Start Bit */                         \
+  bit = request >> 0;                                                           \
+  SW_WRITE_BIT(bit);                    /* APnDP Bit */                         \
+  parity += bit;                                                                \
+  bit = request >> 1;                                                           \
+  SW_WRITE_BIT(bit);                    /* RnW Bit */                           \
+  parity += bit;                                                                \
+  bit = request >> 2;                                                           \
+  SW_WRITE_BIT(bit);                    /* A2 Bit */                            \
+  parity += bit;                                                                \
+  bit = request >> 3;                                                           \
+  SW_WRITE_BIT(bit);                    /* A3 Bit */                            \
+  parity += bit;                                                                \
+  SW_WRITE_BIT(parity);                 /* Parity Bit */                        \
+  SW_WRITE_BIT(0U);                     /* Stop Bit */                          \
+  SW_WRITE_BIT(1U);                     /* Park Bit */                          \
+                                                                                \
+  /* Turnaround */                                                              \
+  PIN_SWDIO_OUT_DISABLE();                                                      \
+  for (n = DAP_Data.swd_conf.turnaround; n; n--) {                              \
+    SW_CLOCK_CYCLE();                                                           \
+  }                                                                             \
+                                                                                \
+  /* Acknowledge response */                                                    \
+  SW_READ_BIT(bit);                                                             \
+  ack  = bit << 0;                                                              \
+  SW_READ_BIT(bit);                                                             \
+  ack |= bit << 1;                                                              \
+  SW_READ_BIT(bit);                                                             \
+  ack |= bit << 2;                                                              \
+                                                                                \
+  if (ack == DAP_TRANSFER_OK) {         /* OK response */                       \
+    /* Data transfer */                                                         \
+    if (request & DAP_TRANSFER_RnW) {                                           \
+      /* Read data */                                                           \
+      val = 0U;                                                                 \
+      parity = 0U;                                                              \
+      UNROLL_32({                                                               \
+        SW_READ_BIT(bit);               /* Read RDATA[0:31] */                  \
+        parity += bit;                                                          \
+        val >>= 1;                                                              \
+        val  |= bit << 31;                                                      \
+      })                                                                        \
+      SW_READ_BIT(bit);                 /* Read Parity */                       \
+      if ((parity ^ bit) & 1U) {                                                \
+        ack = DAP_TRANSFER_ERROR;                                               \
+      }                                                                         \
+      if (data) { *data = val; }                                                \
+      /* Turnaround */                                                          \
+      for (n = DAP_Data.swd_conf.turnaround; n; n--) {                          \
+        SW_CLOCK_CYCLE();                                                       \
+      }                                                                         \
+      PIN_SWDIO_OUT_ENABLE();                                                   \
+    } else {                                                                    \
+      /* Turnaround */                                                          \
+      for (n = DAP_Data.swd_conf.turnaround; n; n--) {                          \
+        SW_CLOCK_CYCLE();                                                       \
+      }                                                                         \
+      PIN_SWDIO_OUT_ENABLE();                                                   \
+      /* Write data */                                                          \
+      val = *data;                                                              \
+      parity = 0U;                                                              \
+      UNROLL_32({                                                               \
+        SW_WRITE_BIT(val);              /* Write WDATA[0:31] */                 \
+        parity += val;                                                          \
+        val >>= 1;                                                              \
+      })                                                                        \
+      SW_WRITE_BIT(parity);             /* Write Parity Bit */                  \
+    }                                                                           \
+    /* Capture Timestamp */                                                     \
+    if (request & DAP_TRANSFER_TIMESTAMP) {                                     \
+      DAP_Data.timestamp = TIMESTAMP_GET();                                     \
+    }                                                                           \
+    /* Idle cycles */                                                           \
+    n = DAP_Data.transfer.idle_cycles;                                          \
+    if (n) {                                                                    \
+      PIN_SWDIO_OUT(0U);                                                        \
+      for (; n; n--) {                                                          \
+        SW_CLOCK_CYCLE();                                                       \
+      }                                                                         \
+    }                                                                           \
+    PIN_SWDIO_OUT(1U);                                                          \
+    return ((uint8_t)ack);                                                      \
+  }                                                                             \
+                                                                                \
+  if ((ack == DAP_TRANSFER_WAIT) || (ack == DAP_TRANSFER_FAULT)) {              \
+    /* WAIT or FAULT response */                                                \
+    if (DAP_Data.swd_conf.data_phase && ((request & DAP_TRANSFER_RnW) != 0U)) { \
+      for (n = 32U+1U; n; n--) {                                                \
+        SW_CLOCK_CYCLE();               /* Dummy Read RDATA[0:31] + Parity */   \
+      }                                                                         \
+    }                                                                           \
+    /* Turnaround */                                                            \
+    for (n = DAP_Data.swd_conf.turnaround; n; n--) {                            \
+      SW_CLOCK_CYCLE();                                                         \
+    }                                                                           \
+    PIN_SWDIO_OUT_ENABLE();                                                     \
+    if (DAP_Data.swd_conf.data_phase && ((request & DAP_TRANSFER_RnW) == 0U)) { \
+      PIN_SWDIO_OUT(0U);                                                        \
+      for (n = 32U+1U; n; n--) {                                                \
+        SW_CLOCK_CYCLE();               /* Dummy Write WDATA[0:31] + Parity */  \
+      }                                                                         \
+    }                                                                           \
+    PIN_SWDIO_OUT(1U);                                                          \
+    return ((uint8_t)ack);                                                      \
+  }                                                                             \
+                                                                                \
+  /* Protocol error */                                                          \
+  for (n = DAP_Data.swd_conf.turnaround + 32U + 1U; n; n--) {                   \
+    SW_CLOCK_CYCLE();                   /* Back off data phase */               \
+  }                                                                             \
+  PIN_SWDIO_OUT_ENABLE();                                                       \
+  PIN_SWDIO_OUT(1U);                                                            \
+  return ((uint8_t)ack);                                                        \
+}
+
+
+// Clock tier calibration
+//   Measure one block of calibration cycles (count x 8 clock cycles)
+#define SWJ_CalibrationFunction(speed) /**/                                     \
+static void IRAM_ATTR SWJ_Calibration_##speed (uint32_t count) {                \
+  for (; count; count--) {                                                      \
+    UNROLL_8(SW_CALIBRATION_CYCLE();)                                           \
+  }                                                                             \
+}
+
+#endif  /* (DAP_SWD != 0) */
+
+
+#undef  PIN_DELAY_LOW
+#undef  PIN_DELAY_WRITE
+#undef  PIN_DELAY_HIGH
+#define PIN_DELAY_LOW()   PIN_DELAY_FAST()
+#define PIN_DELAY_WRITE()
+#define PIN_DELAY_HIGH()
+#if ((DAP_SWD != 0) || (DAP_JTAG != 0))
+SWJ_SequenceFunction(Fast)
+#endif
+#if (DAP_SWD != 0)
+SWD_SequenceFunction(Fast)
+SWD_TransferFunction(Fast)
+SWJ_CalibrationFunction(Fast)
+#endif
+
+#undef  PIN_DELAY_LOW
+#undef  PIN_DELAY_WRITE
+#undef  PIN_DELAY_HIGH
+#define PIN_DELAY_LOW()   PIN_DELAY_SLOW(DAP_Data.clock_delay)
+#define PIN_DELAY_WRITE() PIN_DELAY_SLOW(DAP_Data.clock_delay)
+#define PIN_DELAY_HIGH()  PIN_DELAY_SLOW(DAP_Data.clock_delay)
+#if ((DAP_SWD != 0) || (DAP_JTAG != 0))
+SWJ_SequenceFunction(Slow)
+#endif
+#if (DAP_SWD != 0)
+SWD_SequenceFunction(Slow)
+SWD_TransferFunction(Slow)
+SWJ_CalibrationFunction(Slow)
+#endif
+
+
+#if (DAP_SWD != 0)
 // SWD Transfer I/O
 //   request: A[3:2] RnW APnDP
 //   data:    DATA[31:0]
 //   return:  ACK[2:0]
 uint8_t  SWD_Transfer(uint32_t request, uint32_t *data) {
+  uint8_t ack;
+
   switch (SWD_TransferSpeed) {
     case kTransfer_SPI:
-      return SWD_Transfer_SPI(request, data);
+#if (USE_SPI_FUSED_TRANSFER == 1)
+      ack = SWD_Transfer_SPI_Fused(request, data);
+#else
+      ack = SWD_Transfer_SPI(request, data);
+#endif
+      break;
     case kTransfer_GPIO_fast:
-      return SWD_Transfer_GPIO(request, data, 0);
+      ack = SWD_Transfer_Fast(request, data);
+      break;
     case kTransfer_GPIO_normal:
-      return SWD_Transfer_GPIO(request, data, 1);
+      ack = SWD_Transfer_Slow(request, data);
+      break;
     default:
-      return SWD_Transfer_GPIO(request, data, 1);
+      ack = SWD_Transfer_Slow(request, data);
+      break;
+  }
+
+  // Track DP SELECT
+  if ((request & (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | DAP_TRANSFER_A2 | DAP_TRANSFER_A3)) == DP_SELECT) {
+    SWD_Select      = *data;
+    SWD_SelectValid = (ack == DAP_TRANSFER_OK) ? 1U : 0U;
+  }
+
+  return ack;
+}
+
+
+// Get the last value written to DP SELECT
+//   select: pointer to SELECT value
+//   return: 1 when the value is known, 0 otherwise
+uint8_t SWD_GetSelect (uint32_t *select) {
+  *select = SWD_Select;
+  return SWD_SelectValid;
+}
+
+
+// Forget DP SELECT and TARGETSEL, the port was driven by someone else
+//   return: none
+void SWD_InvalidateSelect (void) {
+  SWD_SelectValid    = 0U;
+  SWD_TargetSelValid = 0U;
+}
+
+// Write DP TARGETSEL after a line reset, no target drives the ACK
+//   targetsel: TARGETSEL value
+//   return:    none
+void SWD_WriteTargetSel (uint32_t targetsel) {
+  static const uint8_t header = 0x99U;      // Start, DP, Write, A[3:2]=11b, Parity=0, Stop, Park
+  uint8_t data[5];
+  uint8_t ack;
+
+  data[0] = (uint8_t)(targetsel >>  0);
+  data[1] = (uint8_t)(targetsel >>  8);
+  data[2] = (uint8_t)(targetsel >> 16);
+  data[3] = (uint8_t)(targetsel >> 24);
+  data[4] = ParityEvenUint32(targetsel);    // Parity, then two idle cycles
+
+  SWD_Sequence(8U, &header, NULL);
+  SWD_Sequence(5U | SWD_SEQUENCE_DIN, NULL, &ack); // Turnaround, ACK (not driven), Turnaround
+  SWD_Sequence(35U, data, NULL);
+
+  SWD_TargetSel      = targetsel;
+  SWD_TargetSelValid = 1U;
+}
+
+// Get the last value written with SWD_WriteTargetSel()
+//   targetsel: pointer to TARGETSEL value
+//   return:    1 when the target is still selected, 0 otherwise
+uint8_t SWD_GetTargetSel (uint32_t *targetsel) {
+  *targetsel = SWD_TargetSel;
+  return SWD_TargetSelValid;
+}
+
+
+#if (USE_SWD_OVERRUN_STREAM == 1) && (defined CONFIG_IDF_TARGET_ESP32C3 || defined CONFIG_IDF_TARGET_ESP32S3)
+
+#define SWD_STREAM_MIN_COUNT  16U
+#define SWD_STREAM_STICKY     (STICKYORUN | STICKYCMP | STICKYERR | WDATAERR)
+#define SWD_STREAM_CLEAR      (ORUNERRCLR | STKCMPCLR | STKERRCLR | WDERRCLR)
+
+// SWD Transfer I/O with WAIT retry
+//   request: A[3:2] RnW APnDP
+//   data:    DATA[31:0]
+//   return:  ACK[2:0]
+static uint8_t SWD_TransferRetry (uint32_t request, uint32_t *data) {
+  uint32_t retry;
+  uint8_t  ack;
+
+  retry = DAP_Data.transfer.retry_count;
+  do {
+    ack = SWD_Transfer_SPI(request, data);
+  } while ((ack == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+
+  return ack;
+}
+
+// Write CTRL/STAT while overrun detection may still be enabled. A WAIT for
+// the pending AP write sets STICKYORUN, which is cleared before each attempt.
+//   ctrl:   CTRL/STAT value
+//   clear:  ABORT value used to clear the sticky flags
+//   return: ACK[2:0]
+static uint8_t SWD_StreamWriteCtrl (uint32_t ctrl, uint32_t clear) {
+  uint32_t retry;
+  uint32_t val;
+  uint8_t  ack;
+
+  retry = DAP_Data.transfer.retry_count;
+  do {
+    val = clear;
+    SWD_Transfer_SPI(DP_ABORT, &val);
+    val = ctrl;
+    ack = SWD_Transfer_SPI(DP_CTRL_STAT, &val);
+  } while ((ack == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+
+  return ack;
+}
+
+// Stream a MEM-AP DRW write block with overrun detection enabled
+//   request: A[3:2] RnW APnDP
+//   data:    pointer to write data (little endian)
+//   count:   number of words
+//   return:  DAP_TRANSFER_OK when the whole block has been written and the
+//            last write has completed. Anything else means that the block was
+//            not (completely) written and TAR has been restored, the caller
+//            must write the block in normal mode.
+uint8_t SWD_TransferStream (uint32_t request, const uint8_t *data, uint32_t count) {
+  uint32_t ctrl, csw, tar, stat;
+  uint32_t val;
+  uint32_t n;
+  uint8_t  requestByte;
+  uint8_t  ack;
+  uint8_t  ok;
+
+  if ((SWD_TransferSpeed != kTransfer_SPI) || (count < SWD_STREAM_MIN_COUNT)) {
+    return DAP_TRANSFER_ERROR;
+  }
+  if ((request & (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | DAP_TRANSFER_A2 | DAP_TRANSFER_A3)) !=
+      (DAP_TRANSFER_APnDP | AP_DRW)) {
+    return DAP_TRANSFER_ERROR;
+  }
+  // CTRL/STAT, CSW and TAR must be reachable without touching SELECT
+  if ((SWD_SelectValid == 0U) || ((SWD_Select & (APBANKSEL | DPBANKSEL)) != 0U)) {
+    return DAP_TRANSFER_ERROR;
+  }
+
+  // Not while the host uses pushed operations or has pending errors
+  if (SWD_TransferRetry(DP_CTRL_STAT | DAP_TRANSFER_RnW, &ctrl) != DAP_TRANSFER_OK) {
+    return DAP_TRANSFER_ERROR;
+  }
+  if ((ctrl & (ORUNDETECT | TRNMODE | SWD_STREAM_STICKY)) != 0U) {
+    return DAP_TRANSFER_ERROR;
+  }
+
+  // Rewriting the block is only harmless for auto-incremented memory
+  if ((SWD_TransferRetry(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_CSW, NULL) != DAP_TRANSFER_OK) ||
+      (SWD_TransferRetry(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_TAR, &csw) != DAP_TRANSFER_OK) ||
+      (SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, &tar) != DAP_TRANSFER_OK)) {
+    return DAP_TRANSFER_ERROR;
+  }
+  if ((csw & CSW_ADDRINC) != CSW_SADDRINC) {
+    return DAP_TRANSFER_ERROR;
+  }
+
+  ctrl &= CSYSPWRUPREQ | CDBGPWRUPREQ | CDBGRSTREQ | TRNCNT | MASKLANE;
+  val = ctrl | ORUNDETECT;
+  if (SWD_TransferRetry(DP_CTRL_STAT, &val) != DAP_TRANSFER_OK) {
+    return DAP_TRANSFER_ERROR;
+  }
+
+  requestByte = 0x81U | (((uint8_t)(request & 0xFU)) << 1U) | (ParityEvenUint8(request & 0xFU) << 5U);
+  n = DAP_Data.transfer.idle_cycles;
+
+  // The next word is prepared while the previous one is on the wire
+  DAP_SPI_Write_Posted_Begin(n);
+  while (count-- && !DAP_TransferAbort) {
+    val = (uint32_t)(*(data+0) <<  0) |
+          (uint32_t)(*(data+1) <<  8) |
+          (uint32_t)(*(data+2) << 16) |
+          (uint32_t)(*(data+3) << 24);
+    data += 4;
+    DAP_SPI_Write_Posted(requestByte, val, ParityEvenUint32(val));
+  }
+  DAP_SPI_Write_Posted_End();
+  PIN_SWDIO_TMS_SET();
+
+  // CTRL/STAT can be read even while the last write is pending
+  ack = SWD_Transfer_SPI(DP_CTRL_STAT | DAP_TRANSFER_RnW, &stat);
+  ok = (ack == DAP_TRANSFER_OK) && ((stat & SWD_STREAM_STICKY) == 0U) && !DAP_TransferAbort;
+
+  // Leave overrun detection mode. A FAULT here means a sticky error beyond
+  // the overrun flag, so the block is given up and all flags are cleared.
+  ack = SWD_StreamWriteCtrl(ctrl, ok ? ORUNERRCLR : SWD_STREAM_CLEAR);
+  if (ack == DAP_TRANSFER_FAULT) {
+    ok = 0U;
+    ack = SWD_StreamWriteCtrl(ctrl, SWD_STREAM_CLEAR);
+  }
+
+  // Check last write
+  if (ok && (SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, NULL) == DAP_TRANSFER_OK)) {
+    return DAP_TRANSFER_OK;
+  }
+
+  val = SWD_STREAM_CLEAR;
+  SWD_Transfer_SPI(DP_ABORT, &val);
+  if (ack == DAP_TRANSFER_OK) {
+    SWD_TransferRetry(DAP_TRANSFER_APnDP | AP_TAR, &tar);
+  }
+
+  return DAP_TRANSFER_ERROR;
+}
+
+#else
+
+uint8_t SWD_TransferStream (uint32_t request, const uint8_t *data, uint32_t count) {
+  (void)request;
+  (void)data;
+  (void)count;
+  return DAP_TRANSFER_ERROR;
+}
+
+#endif
+
+
+// Nominal values, used until SWJ_Calibrate() has measured the real ones
+SWJ_Calibration_t SWJ_Calibration = {
+  .delay_ps    = (uint32_t)((DELAY_SLOW_CYCLES    * 1000000000000ULL) / BUS_CLOCK_FIXED),
+  .overhead_ps = (uint32_t)((IO_PORT_WRITE_CYCLES * 1000000000000ULL) / BUS_CLOCK_FIXED),
+  .fast_clock  = SWJ_FAST_CLOCK_NOMINAL,
+};
+
+#define SWJ_CALIBRATION_TICKS  (TIMESTAMP_CLOCK / 1000U)  // about 1ms per sample
+#define SWJ_CALIBRATION_ROUNDS 4U
+#define SWJ_CALIBRATION_DELAY1 1U
+#define SWJ_CALIBRATION_DELAY2 17U
+
+// Time one calibration function
+//   fn:     calibration function
+//   return: duration of a single clock cycle in ps, 0 when the timer is not usable
+static uint32_t SWJ_MeasureCycle (void (*fn)(uint32_t)) {
+  uint32_t count, ticks, start, round;
+  uint64_t best;
+  uint64_t cycle;
+
+  // Find a block size which spans at least SWJ_CALIBRATION_TICKS
+  count = 16U;
+  do {
+    start = TIMESTAMP_GET();
+    fn(count);
+    ticks = (TIMESTAMP_GET() - start) & 0x7FFFFFFFU;
+    if (ticks >= SWJ_CALIBRATION_TICKS) {
+      break;
+    }
+    count <<= 1;
+  } while (count < (1U << 20));
+
+  if (ticks == 0U) {
+    return 0U;
+  }
+
+  // Take the shortest run, anything longer has been interrupted
+  best = UINT64_MAX;
+  for (round = 0U; round < SWJ_CALIBRATION_ROUNDS; round++) {
+    start = TIMESTAMP_GET();
+    fn(count);
+    ticks = (TIMESTAMP_GET() - start) & 0x7FFFFFFFU;
+    cycle = ((uint64_t)ticks * (1000000000000ULL / TIMESTAMP_CLOCK)) / (count * 8U);
+    if (cycle < best) {
+      best = cycle;
+    }
+  }
+
+  return (uint32_t)best;
+}
+
+// Measure the clock generated by the GPIO engines with the Test Domain Timer.
+// The Slow engine is sampled at two delay settings, which gives the cost of
+// one PIN_DELAY_SLOW() iteration and the fixed cost of the pin accesses.
+// SWCLK is only ever driven high here, so the target does not see any clock.
+//   return: none
+void SWJ_Calibrate (void) {
+  uint32_t clock_delay;
+  uint32_t fast, slow1, slow2;
+  uint32_t delay_ps;
+
+  clock_delay = DAP_Data.clock_delay;
+
+  fast = SWJ_MeasureCycle(SWJ_Calibration_Fast);
+  DAP_Data.clock_delay = SWJ_CALIBRATION_DELAY1;
+  slow1 = SWJ_MeasureCycle(SWJ_Calibration_Slow);
+  DAP_Data.clock_delay = SWJ_CALIBRATION_DELAY2;
+  slow2 = SWJ_MeasureCycle(SWJ_Calibration_Slow);
+
+  DAP_Data.clock_delay = clock_delay;
+
+  if ((fast == 0U) || (slow1 == 0U) || (slow2 <= slow1)) {
+    return; // timer not running, keep the nominal values
+  }
+
+  // Both slow samples are full periods: two delays per cycle
+  delay_ps = (slow2 - slow1) / (2U * (SWJ_CALIBRATION_DELAY2 - SWJ_CALIBRATION_DELAY1));
+  if (delay_ps == 0U) {
+    return; // difference below the timer resolution, keep the nominal values
+  }
+
+  SWJ_Calibration.delay_ps = delay_ps;
+  if (slow1 / 2U > SWJ_Calibration.delay_ps * SWJ_CALIBRATION_DELAY1) {
+    SWJ_Calibration.overhead_ps = slow1 / 2U - SWJ_Calibration.delay_ps * SWJ_CALIBRATION_DELAY1;
+  } else {
+    SWJ_Calibration.overhead_ps = 0U;
   }
+  SWJ_Calibration.fast_clock = (uint32_t)(1000000000000ULL / fast);
 }
 
 #endif  /* (DAP_SWD != 0) */
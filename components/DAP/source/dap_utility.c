@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "components/DAP/include/dap_utility.h"
 
 const uint8_t kParityByteTable[256] =
@@ -8,3 +10,84 @@ const uint8_t kParityByteTable[256] =
 
     P6(0), P6(1), P6(1), P6(0)
 };
+
+// Half-byte table, small enough for the ESP8266 and fast enough for the SWD read rate
+static const uint32_t kCrc32NibbleTable[16] =
+{
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+uint32_t Crc32(uint32_t crc, const uint8_t *data, uint32_t size)
+{
+    crc = ~crc;
+    while (size--) {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ kCrc32NibbleTable[crc & 0xF];
+        crc = (crc >> 4) ^ kCrc32NibbleTable[crc & 0xF];
+    }
+    return ~crc;
+}
+
+static int Lz4ReadLength(const uint8_t **ip, const uint8_t *iend, uint32_t *len)
+{
+    uint8_t b;
+
+    do {
+        if (*ip >= iend)
+            return -1;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return 0;
+}
+
+// Every length and offset is checked, so a corrupted block cannot write outside dst
+int Lz4DecodeBlock(const uint8_t *src, uint32_t src_size, uint8_t *dst, uint32_t dst_size)
+{
+    const uint8_t *ip = src;
+    const uint8_t *iend = src + src_size;
+    const uint8_t *match;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + dst_size;
+    uint32_t token, len, offset;
+
+    while (ip < iend) {
+        token = *ip++;
+
+        // Literals
+        len = token >> 4;
+        if (len == 15 && Lz4ReadLength(&ip, iend, &len) < 0)
+            return -1;
+        if (len > (uint32_t)(iend - ip) || len > (uint32_t)(oend - op))
+            return -1;
+        memcpy(op, ip, len);
+        op += len;
+        ip += len;
+
+        // The last sequence has no match
+        if (ip == iend)
+            break;
+
+        // Match, which may overlap the output it copies
+        if (iend - ip < 2)
+            return -1;
+        offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (uint32_t)(op - dst))
+            return -1;
+
+        len = token & 0xF;
+        if (len == 15 && Lz4ReadLength(&ip, iend, &len) < 0)
+            return -1;
+        len += 4;
+        if (len > (uint32_t)(oend - op))
+            return -1;
+
+        match = op - offset;
+        while (len--)
+            *op++ = *match++;
+    }
+
+    return op - dst;
+}
@@ -0,0 +1,299 @@
+/**
+ * @file mem_cache.c
+ * @brief Probe-side cache for read-only target memory
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * The host declares read-only ranges (flash: vector table, code, constants).
+ * swd_read_memory fills the cache with whole lines inside those ranges and
+ * serves repeated reads from it, so disassembly and unwinding do not read the
+ * same flash over SWD again. Nothing outside the ranges is cached.
+ *
+ * The cache is direct mapped. Lines are dropped on any swd_host write that
+ * overlaps them. All of it is dropped on flash algorithm execution, target
+ * reset, connect, target selection, a raw DAP_Transfer write to an AP data
+ * register (its address is not known here), and on an explicit flush. The AP
+ * register bank is followed from raw SELECT writes, so only CSW and TAR writes
+ * in a known bank 0 leave the cache alone.
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <string.h>
+
+#include "main/dap_configuration.h"
+
+#include "components/DAP/config/DAP_config.h"
+#include "components/DAP/include/DAP.h"
+#include "components/DAP/include/mem_cache.h"
+
+#if (USE_MEM_CACHE == 1)
+
+#define MEM_CACHE_LINE          64U
+#if defined CONFIG_IDF_TARGET_ESP8266
+#define MEM_CACHE_LINES         64U
+#else
+#define MEM_CACHE_LINES         256U
+#endif
+#define MEM_CACHE_RANGES        8U
+#define MEM_CACHE_VALID         1U  // tag bit, lines are aligned so bit 0 is free
+#define MEM_CACHE_BANK_UNKNOWN  0xFFU
+
+typedef struct {
+  uint32_t start;
+  uint32_t end;             // exclusive
+} MEM_CacheRange_t;
+
+static uint8_t  MEM_CacheData[MEM_CACHE_LINES][MEM_CACHE_LINE];
+static uint32_t MEM_CacheTag[MEM_CACHE_LINES];     // line address | MEM_CACHE_VALID
+static MEM_CacheRange_t MEM_CacheRange[MEM_CACHE_RANGES];
+static uint32_t MEM_CacheRangeCount;
+static uint32_t MEM_CacheHits;
+static uint32_t MEM_CacheMisses;
+static uint8_t  MEM_CacheApBank = MEM_CACHE_BANK_UNKNOWN;  // SELECT[7:4] as last written by the host
+
+
+// Check if [address, address + size) overlaps a read-only range
+static uint8_t MEM_CacheOverlaps(uint32_t address, uint32_t size) {
+  uint32_t n;
+
+  for (n = 0U; n < MEM_CacheRangeCount; n++) {
+    if ((address < MEM_CacheRange[n].end) &&
+        ((MEM_CacheRange[n].start <= address) || (MEM_CacheRange[n].start - address < size))) {
+      return 1U;
+    }
+  }
+  return 0U;
+}
+
+// Check if a whole line lies in one read-only range
+static uint8_t MEM_CacheContains(uint32_t line) {
+  uint32_t n;
+
+  for (n = 0U; n < MEM_CacheRangeCount; n++) {
+    if ((line >= MEM_CacheRange[n].start) && (line < MEM_CacheRange[n].end) &&
+        (MEM_CacheRange[n].end - line >= MEM_CACHE_LINE)) {
+      return 1U;
+    }
+  }
+  return 0U;
+}
+
+void mem_cache_flush(void) {
+  memset(MEM_CacheTag, 0, sizeof(MEM_CacheTag));
+  MEM_CacheApBank = MEM_CACHE_BANK_UNKNOWN;  // SELECT may have been changed behind the host
+}
+
+// Drop the lines that overlap a write
+void mem_cache_invalidate(uint32_t address, uint32_t size) {
+  uint32_t line;
+  uint32_t slot;
+  uint32_t n;
+
+  if ((size == 0U) || !MEM_CacheOverlaps(address, size)) {
+    return;
+  }
+  if (size > MEM_CACHE_LINES * MEM_CACHE_LINE) {
+    mem_cache_flush();
+    return;
+  }
+
+  line = address & ~(MEM_CACHE_LINE - 1U);
+  for (n = (address - line + size + MEM_CACHE_LINE - 1U) / MEM_CACHE_LINE; n; n--) {
+    slot = (line / MEM_CACHE_LINE) % MEM_CACHE_LINES;
+    if (MEM_CacheTag[slot] == (line | MEM_CACHE_VALID)) {
+      MEM_CacheTag[slot] = 0U;
+    }
+    line += MEM_CACHE_LINE;
+  }
+}
+
+// Read target memory through the cache
+//   read:   uncached read function
+//   return: 1 on success, 0 otherwise
+uint8_t mem_cache_read(uint32_t address, uint8_t *data, uint32_t size, mem_cache_read_t read) {
+  uint32_t line;
+  uint32_t slot;
+  uint32_t n;
+
+  if (!MEM_CacheOverlaps(address, size)) {
+    return read(address, data, size);
+  }
+
+  for (; size; address += n, data += n, size -= n) {
+    line = address & ~(MEM_CACHE_LINE - 1U);
+    n = MEM_CACHE_LINE - (address - line);
+    if (n > size) {
+      n = size;
+    }
+
+    // Lines on the edge of a range are never cached
+    if (!MEM_CacheContains(line)) {
+      if (!read(address, data, n)) {
+        return 0U;
+      }
+      continue;
+    }
+
+    slot = (line / MEM_CACHE_LINE) % MEM_CACHE_LINES;
+    if (MEM_CacheTag[slot] == (line | MEM_CACHE_VALID)) {
+      MEM_CacheHits++;
+    } else {
+      MEM_CacheMisses++;
+      MEM_CacheTag[slot] = 0U;
+      if (!read(line, MEM_CacheData[slot], MEM_CACHE_LINE)) {
+        return 0U;
+      }
+      MEM_CacheTag[slot] = line | MEM_CACHE_VALID;
+    }
+    memcpy(data, &MEM_CacheData[slot][address - line], n);
+  }
+  return 1U;
+}
+
+// Follow a raw register write: track the AP bank from SELECT and tell if the
+// write may change target memory
+//   req:    transfer request byte
+//   data:   pointer to the written value
+//   return: 1 when the cache must be flushed
+static uint8_t MEM_CacheCheckWrite(uint32_t req, const uint8_t *data) {
+  if ((req & DAP_TRANSFER_APnDP) == 0U) {
+    if ((req & (DAP_TRANSFER_A2 | DAP_TRANSFER_A3)) == DAP_TRANSFER_A3) {
+      MEM_CacheApBank = (data[0] >> 4) & 0x0FU;     // DP SELECT
+    }
+    return 0U;
+  }
+
+  // CSW, TAR and the upper TAR word only set up an access
+  if ((MEM_CacheApBank == 0U) &&
+      ((req & (DAP_TRANSFER_A2 | DAP_TRANSFER_A3)) != (DAP_TRANSFER_A2 | DAP_TRANSFER_A3))) {
+    return 0U;
+  }
+  return 1U;    // DRW, BD0..BD3 or an unknown bank
+}
+
+// Flush the cache when a raw transfer writes an AP data register
+//   request: DAP_Transfer or DAP_TransferBlock request, after the command ID
+//   block:   1 for DAP_TransferBlock
+void mem_cache_check_transfer(const uint8_t *request, uint32_t block) {
+  uint32_t count;
+  uint32_t req;
+  uint8_t  flush;
+
+  flush = 0U;
+  if (block) {
+    count = (uint32_t)request[1] | ((uint32_t)request[2] << 8);
+    req   = request[3];
+    if (((req & DAP_TRANSFER_RnW) == 0U) && count) {
+      // the last word is the one left in the register
+      flush = MEM_CacheCheckWrite(req, request + 4 + 4U * (count - 1U));
+    }
+  } else {
+    count = request[1];
+    request += 2;
+    for (; count; count--) {
+      req = *request++;
+      if ((req & DAP_TRANSFER_RnW) == 0U) {
+        if ((req & DAP_TRANSFER_MATCH_MASK) == 0U) {
+          flush |= MEM_CacheCheckWrite(req, request);
+        }
+        request += 4;
+      } else if (req & DAP_TRANSFER_MATCH_VALUE) {
+        request += 4;
+      }
+    }
+  }
+
+  if (flush && MEM_CacheRangeCount) {
+    // keep the bank seen in this request, the flush only concerns cached lines
+    req = MEM_CacheApBank;
+    mem_cache_flush();
+    MEM_CacheApBank = (uint8_t)req;
+  }
+}
+
+// Process Memory Cache command and prepare response
+//   request:  pointer to request data
+//   response: pointer to response data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_MemoryCache(const uint8_t *request, uint8_t *response) {
+  uint32_t address;
+  uint32_t size;
+
+  switch (request[0]) {
+    case MEM_CACHE_FLUSH:
+      mem_cache_flush();
+      break;
+
+    case MEM_CACHE_ADD_RANGE:
+      address = (uint32_t)(request[1] <<  0) |
+                (uint32_t)(request[2] <<  8) |
+                (uint32_t)(request[3] << 16) |
+                (uint32_t)(request[4] << 24);
+      size    = (uint32_t)(request[5] <<  0) |
+                (uint32_t)(request[6] <<  8) |
+                (uint32_t)(request[7] << 16) |
+                (uint32_t)(request[8] << 24);
+      if ((MEM_CacheRangeCount == MEM_CACHE_RANGES) || (size == 0U) || (address + size < address)) {
+        *response = DAP_ERROR;
+        return ((9U << 16) | 1U);
+      }
+      MEM_CacheRange[MEM_CacheRangeCount].start = address;
+      MEM_CacheRange[MEM_CacheRangeCount].end   = address + size;
+      MEM_CacheRangeCount++;
+      *response = DAP_OK;
+      return ((9U << 16) | 1U);
+
+    case MEM_CACHE_CLEAR_RANGES:
+      MEM_CacheRangeCount = 0U;
+      mem_cache_flush();
+      break;
+
+    case MEM_CACHE_STATUS:
+      response[0] = DAP_OK;
+      response[1] = (uint8_t)(MEM_CacheHits   >>  0);
+      response[2] = (uint8_t)(MEM_CacheHits   >>  8);
+      response[3] = (uint8_t)(MEM_CacheHits   >> 16);
+      response[4] = (uint8_t)(MEM_CacheHits   >> 24);
+      response[5] = (uint8_t)(MEM_CacheMisses >>  0);
+      response[6] = (uint8_t)(MEM_CacheMisses >>  8);
+      response[7] = (uint8_t)(MEM_CacheMisses >> 16);
+      response[8] = (uint8_t)(MEM_CacheMisses >> 24);
+      return ((1U << 16) | 9U);
+
+    default:
+      *response = DAP_ERROR;
+      return ((1U << 16) | 1U);
+  }
+
+  *response = DAP_OK;
+  return ((1U << 16) | 1U);
+}
+
+#else
+
+uint8_t mem_cache_read(uint32_t address, uint8_t *data, uint32_t size, mem_cache_read_t read) {
+  return read(address, data, size);
+}
+
+void mem_cache_invalidate(uint32_t address, uint32_t size) {
+  (void)address;
+  (void)size;
+}
+
+void mem_cache_flush(void) {
+}
+
+void mem_cache_check_transfer(const uint8_t *request, uint32_t block) {
+  (void)request;
+  (void)block;
+}
+
+uint32_t DAP_MemoryCache(const uint8_t *request, uint8_t *response) {
+  *response = DAP_ERROR;
+  return (((request[0] == MEM_CACHE_ADD_RANGE) ? 9U : 1U) << 16) | 1U;
+}
+
+#endif
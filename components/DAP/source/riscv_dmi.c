@@ -0,0 +1,614 @@
+/**
+ * @file riscv_dmi.c
+ * @brief RISC-V Debug Module access over the JTAG DTM
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * Executes lists of DMI operations on the probe, so the host does not have to
+ * build every dmi scan with JTAG_Sequence and poll for busy itself. The request
+ * carries the operations and the response only carries the results.
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "components/DAP/config/DAP_config.h"
+#include "components/DAP/include/DAP.h"
+#include "components/DAP/include/riscv_dmi.h"
+
+#if (DAP_JTAG != 0)
+
+// DTM instructions
+#define DTM_IR_DTMCS            0x10U
+#define DTM_IR_DMI              0x11U
+
+// dtmcs fields
+#define DTMCS_VERSION(v)        ((v) & 0xFU)
+#define DTMCS_ABITS(v)          (((v) >> 4) & 0x3FU)
+#define DTMCS_IDLE(v)           (((v) >> 12) & 0x7U)
+#define DTMCS_DMIRESET          (1U << 16)
+
+// dmi op field
+#define DMI_OP_NOP              0U
+#define DMI_OP_READ             1U
+#define DMI_OP_WRITE            2U
+#define DMI_OP_SUCCESS          0U
+#define DMI_OP_BUSY             3U
+
+// Debug Module registers
+#define DM_DATA0                0x04U
+#define DM_ABSTRACTCS           0x16U
+#define DM_COMMAND              0x17U
+#define DM_ABSTRACTAUTO         0x18U
+#define DM_PROGBUF0             0x20U
+#define DM_SBCS                 0x38U
+#define DM_SBADDRESS0           0x39U
+#define DM_SBDATA0              0x3CU
+
+#define ABSTRACTCS_CMDERR       (7U << 8)
+#define ABSTRACTCS_BUSY         (1U << 12)
+#define CMDERR_BUSY             1U
+
+#define SBCS_SBBUSYERROR        (1U << 22)
+#define SBCS_SBBUSY             (1U << 21)
+#define SBCS_SBREADONADDR       (1U << 20)
+#define SBCS_SBACCESS32         (2U << 17)
+#define SBCS_SBAUTOINCREMENT    (1U << 16)
+#define SBCS_SBREADONDATA       (1U << 15)
+#define SBCS_SBERROR            (7U << 12)
+
+// Access Register abstract command, 32-bit
+#define AC_ACCESS_REGISTER(regno, write, transfer, postexec) \
+  ((2U << 20) | ((postexec) << 18) | ((transfer) << 17) | ((write) << 16) | (regno))
+#define REGNO_S0                0x1008U
+#define REGNO_S1                0x1009U
+
+// Program buffer instructions
+#define RV_LW_S1_0_S0           0x00042483U     // lw   s1, 0(s0)
+#define RV_SW_S1_0_S0           0x00942023U     // sw   s1, 0(s0)
+#define RV_ADDI_S0_S0_4         0x00440413U     // addi s0, s0, 4
+#define RV_EBREAK               0x00100073U     // ebreak
+
+#define DMI_BUSY_RETRY          8U
+#define DMI_IDLE_MAX            64U
+#define DMI_POLL_RETRY          100U
+
+static uint32_t dmi_abits;
+static uint32_t dmi_idle;       // learned from busy responses, kept across commands
+
+
+static uint32_t get_u32(const uint8_t *p) {
+  return ((uint32_t)p[0] <<  0) |
+         ((uint32_t)p[1] <<  8) |
+         ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)(v >>  0);
+  p[1] = (uint8_t)(v >>  8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+
+// Scan one dmi operation
+//   op:     operation to start
+//   addr:   DM register address
+//   data:   data to write
+//   prev:   data of the previous operation
+//   return: result of the previous operation
+static uint32_t DMI_Scan(uint32_t op, uint32_t addr, uint32_t data, uint32_t *prev) {
+  uint64_t tdo;
+
+  JTAG_IR(DTM_IR_DMI);
+  tdo = JTAG_DR(dmi_abits + 34U, ((uint64_t)addr << 34) | ((uint64_t)data << 2) | op, dmi_idle);
+  if (prev) {
+    *prev = (uint32_t)(tdo >> 2);
+  }
+  return ((uint32_t)tdo & 3U);
+}
+
+// Clear a sticky dmi error
+static void DMI_Reset(void) {
+  JTAG_IR(DTM_IR_DTMCS);
+  JTAG_DR(32U, DTMCS_DMIRESET, 0U);
+}
+
+// Read dtmcs of the selected device
+//   return: 1 if it is a 0.13 DTM, 0 otherwise
+static uint32_t DMI_Init(void) {
+  uint32_t dtmcs;
+
+  JTAG_IR(DTM_IR_DTMCS);
+  dtmcs = (uint32_t)JTAG_DR(32U, 0U, 0U);
+
+  dmi_abits = DTMCS_ABITS(dtmcs);
+  if ((DTMCS_VERSION(dtmcs) != 1U) || (dmi_abits == 0U) || (dmi_abits > 30U)) {
+    return 0U;
+  }
+  if (dmi_idle < DTMCS_IDLE(dtmcs)) {
+    dmi_idle = DTMCS_IDLE(dtmcs);
+  }
+  return 1U;
+}
+
+// Execute a dmi operation, retrying with more idle cycles while the DM is busy
+//   op:     DMI_OP_READ or DMI_OP_WRITE
+//   addr:   DM register address
+//   data:   data to write or data read
+//   return: DMI status
+static uint32_t DMI_Access(uint32_t op, uint32_t addr, uint32_t *data) {
+  uint32_t result;
+  uint32_t val;
+  uint32_t n;
+
+  for (n = 0U; n < DMI_BUSY_RETRY; n++) {
+    DMI_Scan(op, addr, (op == DMI_OP_WRITE) ? *data : 0U, NULL);
+    result = DMI_Scan(DMI_OP_NOP, 0U, 0U, &val);
+    if (result == DMI_OP_SUCCESS) {
+      if (op == DMI_OP_READ) {
+        *data = val;
+      }
+      return DMI_STATUS_OK;
+    }
+    DMI_Reset();
+    if (result != DMI_OP_BUSY) {
+      return DMI_STATUS_FAILED;
+    }
+    if (dmi_idle < DMI_IDLE_MAX) {
+      dmi_idle = dmi_idle * 2U + 1U;
+    }
+  }
+  return DMI_STATUS_BUSY;
+}
+
+static uint32_t DMI_Read(uint32_t addr, uint32_t *data) {
+  return DMI_Access(DMI_OP_READ, addr, data);
+}
+
+static uint32_t DMI_Write(uint32_t addr, uint32_t data) {
+  return DMI_Access(DMI_OP_WRITE, addr, &data);
+}
+
+// Wait until the abstract command is done
+//   detail: cmderr
+//   return: DMI status
+static uint32_t DMI_AbstractWait(uint8_t *detail) {
+  uint32_t status;
+  uint32_t cs;
+  uint32_t n;
+
+  for (n = 0U; n < DMI_POLL_RETRY; n++) {
+    status = DMI_Read(DM_ABSTRACTCS, &cs);
+    if (status != DMI_STATUS_OK) {
+      return status;
+    }
+    if ((cs & ABSTRACTCS_BUSY) == 0U) {
+      break;
+    }
+  }
+  if (cs & ABSTRACTCS_BUSY) {
+    return DMI_STATUS_BUSY;
+  }
+
+  *detail = (uint8_t)((cs & ABSTRACTCS_CMDERR) >> 8);
+  if (*detail) {
+    DMI_Write(DM_ABSTRACTCS, ABSTRACTCS_CMDERR);
+    return DMI_STATUS_CMDERR;
+  }
+  return DMI_STATUS_OK;
+}
+
+// Execute an abstract command
+//   command: command register value
+//   detail:  cmderr
+//   return:  DMI status
+static uint32_t DMI_Command(uint32_t command, uint8_t *detail) {
+  uint32_t status;
+
+  status = DMI_Write(DM_COMMAND, command);
+  if (status != DMI_STATUS_OK) {
+    return status;
+  }
+  return DMI_AbstractWait(detail);
+}
+
+// Read a GPR with an abstract command
+static uint32_t DMI_ReadReg(uint32_t regno, uint32_t *val, uint8_t *detail) {
+  uint32_t status;
+
+  status = DMI_Command(AC_ACCESS_REGISTER(regno, 0U, 1U, 0U), detail);
+  if (status == DMI_STATUS_OK) {
+    status = DMI_Read(DM_DATA0, val);
+  }
+  return status;
+}
+
+// Write a GPR with an abstract command
+static uint32_t DMI_WriteReg(uint32_t regno, uint32_t val, uint8_t *detail) {
+  uint32_t status;
+
+  status = DMI_Write(DM_DATA0, val);
+  if (status == DMI_STATUS_OK) {
+    status = DMI_Command(AC_ACCESS_REGISTER(regno, 1U, 1U, 0U), detail);
+  }
+  return status;
+}
+
+// Load the program buffer with a load or store followed by an address increment
+static uint32_t DMI_Program(uint32_t insn) {
+  uint32_t status;
+
+  status = DMI_Write(DM_PROGBUF0 + 0U, insn);
+  if (status == DMI_STATUS_OK) {
+    status = DMI_Write(DM_PROGBUF0 + 1U, RV_ADDI_S0_S0_4);
+  }
+  if (status == DMI_STATUS_OK) {
+    status = DMI_Write(DM_PROGBUF0 + 2U, RV_EBREAK);
+  }
+  return status;
+}
+
+// Read memory words through the program buffer
+//   Every read of data0 re-executes "data0 = s1; lw s1, 0(s0); addi s0, s0, 4" with
+//   autoexec. The last word is fetched without postexec, so no word past the end is loaded.
+//   poll:   wait for the abstract command after every word
+//   return: DMI status
+static uint32_t DMI_ProgbufRead(uint32_t address, uint8_t *data, uint32_t words, uint32_t poll, uint8_t *detail) {
+  uint32_t status;
+  uint32_t val;
+  uint32_t autoexec;
+  uint32_t i;
+
+  status = DMI_Program(RV_LW_S1_0_S0);
+  if (status == DMI_STATUS_OK) {
+    status = DMI_Write(DM_DATA0, address);
+  }
+  if (status == DMI_STATUS_OK) {
+    status = DMI_Command(AC_ACCESS_REGISTER(REGNO_S0, 1U, 1U, 1U), detail);
+  }
+  if (status == DMI_STATUS_OK) {
+    status = DMI_Command(AC_ACCESS_REGISTER(REGNO_S1, 0U, 1U, (words > 1U) ? 1U : 0U), detail);
+  }
+  autoexec = (words > 2U) ? 1U : 0U;
+  if ((status == DMI_STATUS_OK) && autoexec) {
+    status = DMI_Write(DM_ABSTRACTAUTO, 1U);
+  }
+
+  for (i = 0U; (status == DMI_STATUS_OK) && (i < words); i++) {
+    if ((i + 2U == words) && autoexec) {
+      autoexec = 0U;
+      status = DMI_Write(DM_ABSTRACTAUTO, 0U);
+    }
+    if (status == DMI_STATUS_OK) {
+      status = DMI_Read(DM_DATA0, &val);
+      put_u32(data + i * 4U, val);
+    }
+    if ((status == DMI_STATUS_OK) && autoexec && poll) {
+      status = DMI_AbstractWait(detail);
+    }
+    if ((status == DMI_STATUS_OK) && (i + 2U == words)) {
+      status = DMI_Command(AC_ACCESS_REGISTER(REGNO_S1, 0U, 1U, 0U), detail);
+    }
+  }
+
+  if (autoexec) {
+    DMI_Write(DM_ABSTRACTAUTO, 0U);
+  }
+  if (status == DMI_STATUS_OK) {
+    status = DMI_AbstractWait(detail);
+  }
+  return status;
+}
+
+// Write memory words through the program buffer
+//   Every write of data0 re-executes "s1 = data0; sw s1, 0(s0); addi s0, s0, 4" with autoexec.
+//   poll:   wait for the abstract command after every word
+//   return: DMI status
+static uint32_t DMI_ProgbufWrite(uint32_t address, const uint8_t *data, uint32_t words, uint32_t poll, uint8_t *detail) {
+  uint32_t status;
+  uint32_t autoexec;
+  uint32_t i;
+
+  status = DMI_Program(RV_SW_S1_0_S0);
+  if (status == DMI_STATUS_OK) {
+    status = DMI_WriteReg(REGNO_S0, address, detail);
+  }
+  if (status == DMI_STATUS_OK) {
+    status = DMI_Write(DM_DATA0, get_u32(data));
+  }
+  if (status == DMI_STATUS_OK) {
+    status = DMI_Command(AC_ACCESS_REGISTER(REGNO_S1, 1U, 1U, 1U), detail);
+  }
+  autoexec = (words > 1U) ? 1U : 0U;
+  if ((status == DMI_STATUS_OK) && autoexec) {
+    status = DMI_Write(DM_ABSTRACTAUTO, 1U);
+  }
+
+  for (i = 1U; (status == DMI_STATUS_OK) && (i < words); i++) {
+    status = DMI_Write(DM_DATA0, get_u32(data + i * 4U));
+    if ((status == DMI_STATUS_OK) && poll) {
+      status = DMI_AbstractWait(detail);
+    }
+  }
+
+  if (autoexec) {
+    DMI_Write(DM_ABSTRACTAUTO, 0U);
+  }
+  if (status == DMI_STATUS_OK) {
+    status = DMI_AbstractWait(detail);
+  }
+  return status;
+}
+
+// Run a program buffer block transfer, s0 and s1 are restored afterwards
+//   write:  0 = read, 1 = write
+//   return: DMI status
+static uint32_t DMI_ProgbufBlock(uint32_t address, uint8_t *data, uint32_t words, uint32_t write, uint8_t *detail) {
+  uint32_t status;
+  uint32_t s0, s1;
+  uint8_t  restore_detail;
+
+  if (words == 0U) {
+    return DMI_STATUS_OK;
+  }
+
+  status = DMI_ReadReg(REGNO_S0, &s0, detail);
+  if (status == DMI_STATUS_OK) {
+    status = DMI_ReadReg(REGNO_S1, &s1, detail);
+  }
+  if (status != DMI_STATUS_OK) {
+    return status;
+  }
+
+  status = write ? DMI_ProgbufWrite(address, data, words, 0U, detail)
+                 : DMI_ProgbufRead(address, data, words, 0U, detail);
+  if ((status == DMI_STATUS_CMDERR) && (*detail == CMDERR_BUSY)) {
+    // The hart is slower than the autoexec stream, do it again waiting for every word
+    status = write ? DMI_ProgbufWrite(address, data, words, 1U, detail)
+                   : DMI_ProgbufRead(address, data, words, 1U, detail);
+  }
+
+  DMI_WriteReg(REGNO_S0, s0, &restore_detail);
+  DMI_WriteReg(REGNO_S1, s1, &restore_detail);
+  return status;
+}
+
+// Wait until the system bus is idle and check sbcs for errors
+//   detail: sberror[2:0], sbbusyerror in bit 3
+//   return: DMI status
+static uint32_t DMI_SbaWait(uint8_t *detail) {
+  uint32_t status;
+  uint32_t cs;
+  uint32_t n;
+
+  for (n = 0U; n < DMI_POLL_RETRY; n++) {
+    status = DMI_Read(DM_SBCS, &cs);
+    if (status != DMI_STATUS_OK) {
+      return status;
+    }
+    if ((cs & SBCS_SBBUSY) == 0U) {
+      break;
+    }
+  }
+  if (cs & SBCS_SBBUSY) {
+    return DMI_STATUS_BUSY;
+  }
+
+  if (cs & (SBCS_SBBUSYERROR | SBCS_SBERROR)) {
+    *detail = (uint8_t)(((cs & SBCS_SBERROR) >> 12) | ((cs & SBCS_SBBUSYERROR) ? 0x08U : 0U));
+    DMI_Write(DM_SBCS, cs & (SBCS_SBBUSYERROR | SBCS_SBERROR));
+    return DMI_STATUS_SBERROR;
+  }
+  return DMI_STATUS_OK;
+}
+
+// Read memory words through the system bus with sbreadondata
+//   poll:   wait for the bus after every word
+//   return: DMI status
+static uint32_t DMI_SbaRead(uint32_t address, uint8_t *data, uint32_t words, uint32_t poll, uint8_t *detail) {
+  const uint32_t sbcs = SBCS_SBREADONADDR | SBCS_SBACCESS32 | SBCS_SBAUTOINCREMENT | SBCS_SBREADONDATA;
+  uint32_t status;
+  uint32_t val;
+  uint32_t i;
+
+  status = DMI_Write(DM_SBCS, sbcs);
+  if (status == DMI_STATUS_OK) {
+    status = DMI_Write(DM_SBADDRESS0, address);
+  }
+  for (i = 0U; (status == DMI_STATUS_OK) && (i < words); i++) {
+    if (poll || (i + 1U == words)) {
+      status = DMI_SbaWait(detail);
+    }
+    if ((status == DMI_STATUS_OK) && (i + 1U == words)) {
+      // Do not start a read past the end of the block
+      status = DMI_Write(DM_SBCS, sbcs & ~SBCS_SBREADONDATA);
+    }
+    if (status == DMI_STATUS_OK) {
+      status = DMI_Read(DM_SBDATA0, &val);
+      put_u32(data + i * 4U, val);
+    }
+  }
+
+  if (status == DMI_STATUS_OK) {
+    status = DMI_SbaWait(detail);
+  }
+  return status;
+}
+
+// Write memory words through the system bus
+//   poll:   wait for the bus after every word
+//   return: DMI status
+static uint32_t DMI_SbaWrite(uint32_t address, const uint8_t *data, uint32_t words, uint32_t poll, uint8_t *detail) {
+  uint32_t status;
+  uint32_t i;
+
+  status = DMI_Write(DM_SBCS, SBCS_SBACCESS32 | SBCS_SBAUTOINCREMENT);
+  if (status == DMI_STATUS_OK) {
+    status = DMI_Write(DM_SBADDRESS0, address);
+  }
+  for (i = 0U; (status == DMI_STATUS_OK) && (i < words); i++) {
+    status = DMI_Write(DM_SBDATA0, get_u32(data + i * 4U));
+    if ((status == DMI_STATUS_OK) && poll) {
+      status = DMI_SbaWait(detail);
+    }
+  }
+
+  if (status == DMI_STATUS_OK) {
+    status = DMI_SbaWait(detail);
+  }
+  return status;
+}
+
+// Run a system bus block transfer, again with polling if the bus was too slow
+//   write:  0 = read, 1 = write
+//   return: DMI status
+static uint32_t DMI_SbaBlock(uint32_t address, uint8_t *data, uint32_t words, uint32_t write, uint8_t *detail) {
+  uint32_t status;
+
+  if (words == 0U) {
+    return DMI_STATUS_OK;
+  }
+
+  status = write ? DMI_SbaWrite(address, data, words, 0U, detail)
+                 : DMI_SbaRead(address, data, words, 0U, detail);
+  if ((status == DMI_STATUS_SBERROR) && (*detail == 0x08U)) {
+    status = write ? DMI_SbaWrite(address, data, words, 1U, detail)
+                   : DMI_SbaRead(address, data, words, 1U, detail);
+  }
+  return status;
+}
+
+
+// Process DMI Transfer command and prepare response
+//   request:  [index:8][count:8] followed by count operations
+//   response: [done:8][status:8][detail:8] followed by read data
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_DMI_Transfer(const uint8_t *request, uint8_t *response) {
+  const uint8_t *request_head;
+  uint8_t       *response_head;
+  uint8_t       *response_end;
+  uint32_t       index;
+  uint32_t       count;
+  uint32_t       done;
+  uint32_t       status;
+  uint32_t       address;
+  uint32_t       words;
+  uint32_t       data;
+  uint8_t        detail;
+  uint8_t        op;
+
+  request_head  = request;
+  response_head = response;
+  response_end  = response + DAP_PACKET_SIZE - 1U;   // Command ID is already in the response
+  response     += 3U;
+
+  index  = *request++;
+  count  = *request++;
+  done   = 0U;
+  detail = 0U;
+  status = DMI_STATUS_OK;
+
+  if ((DAP_Data.debug_port != DAP_PORT_JTAG) || (index >= DAP_Data.jtag_dev.count)) {
+    status = DMI_STATUS_INVALID;
+  } else {
+    DAP_Data.jtag_dev.index = (uint8_t)index;
+    if (!DMI_Init()) {
+      status = DMI_STATUS_FAILED;
+    }
+  }
+
+  // After an error the remaining operations are only parsed
+  for (; count; count--) {
+    op = *request++;
+    switch (op) {
+      case DMI_TRANSFER_READ:
+        address = *request++;
+        if (status == DMI_STATUS_OK) {
+          if (response + 4U > response_end) {
+            status = DMI_STATUS_INVALID;
+            break;
+          }
+          status = DMI_Read(address, &data);
+          put_u32(response, data);
+          response += 4U;
+        }
+        break;
+
+      case DMI_TRANSFER_WRITE:
+        address = *request++;
+        data    = get_u32(request);
+        request += 4U;
+        if (status == DMI_STATUS_OK) {
+          status = DMI_Write(address, data);
+        }
+        break;
+
+      case DMI_TRANSFER_COMMAND:
+        data     = get_u32(request);
+        request += 4U;
+        if (status == DMI_STATUS_OK) {
+          status = DMI_Command(data, &detail);
+        }
+        break;
+
+      case DMI_TRANSFER_SBA_READ:
+      case DMI_TRANSFER_PROGBUF_READ:
+        address  = get_u32(request);
+        words    = (uint32_t)(request[4] | (request[5] << 8));
+        request += 6U;
+        if (status == DMI_STATUS_OK) {
+          if (response + words * 4U > response_end) {
+            status = DMI_STATUS_INVALID;
+            break;
+          }
+          status = (op == DMI_TRANSFER_SBA_READ) ? DMI_SbaBlock(address, response, words, 0U, &detail)
+                                                 : DMI_ProgbufBlock(address, response, words, 0U, &detail);
+          response += words * 4U;
+        }
+        break;
+
+      case DMI_TRANSFER_SBA_WRITE:
+      case DMI_TRANSFER_PROGBUF_WRITE:
+        address  = get_u32(request);
+        words    = (uint32_t)(request[4] | (request[5] << 8));
+        request += 6U;
+        if (status == DMI_STATUS_OK) {
+          status = (op == DMI_TRANSFER_SBA_WRITE) ? DMI_SbaBlock(address, (uint8_t *)request, words, 1U, &detail)
+                                                  : DMI_ProgbufBlock(address, (uint8_t *)request, words, 1U, &detail);
+        }
+        request += words * 4U;
+        break;
+
+      default:
+        // Unknown operation, its length is unknown as well
+        status = DMI_STATUS_INVALID;
+        count  = 1U;
+        break;
+    }
+
+    if (status == DMI_STATUS_OK) {
+      done++;
+    }
+  }
+
+  response_head[0] = (uint8_t)done;
+  response_head[1] = (uint8_t)status;
+  response_head[2] = detail;
+
+  return (((uint32_t)(request - request_head) << 16) | (uint32_t)(response - response_head));
+}
+
+#else
+
+uint32_t DAP_DMI_Transfer(const uint8_t *request, uint8_t *response) {
+  (void)request;
+  response[0] = 0U;
+  response[1] = DMI_STATUS_INVALID;
+  response[2] = 0U;
+  return ((2U << 16) | 3U);
+}
+
+#endif  /* (DAP_JTAG != 0) */
@@ -7,6 +7,11 @@
  *          2021-3-10 Support 3-wire SPI
  *          2022-9-15 Support ESP32C3
  *          2024-6-9  Fix DAP_SPI_WriteBits issue
+ *          2026-10-19 Add posted write for overrun detection streaming
+ *          2026-10-19 Add fused read and write data with idle cycles
+ *          2026-10-19 Pipeline posted writes
+ *          2026-10-19 Support sequences longer than the SPI buffer
+ *          2026-10-19 Add full duplex JTAG shift
  * @version 0.5
  * @date 2024-6-9
  *
@@ -67,6 +72,16 @@
             DAP_SPI.cmd.usr = 1;                   \
             while (DAP_SPI.cmd.usr) continue;      \
         } while(0)
+    #define START_SPI_TRANSMISSION()               \
+        do {                                       \
+            DAP_SPI.cmd.update = 1;                \
+            while (DAP_SPI.cmd.update) continue;   \
+            DAP_SPI.cmd.usr = 1;                   \
+        } while(0)
+    #define WAIT_SPI_TRANSMISSION_DONE()           \
+        do {                                       \
+            while (DAP_SPI.cmd.usr) continue;      \
+        } while(0)
 #endif
 
 /**
@@ -82,15 +97,19 @@ __STATIC_FORCEINLINE int div_round_up(int A, int B)
 }
 
 
+// The SPI data buffer is 16 words, longer sequences are split
+#define SPI_SEQUENCE_CHUNK_BITS (16U * 32U)
+
 /**
  * @brief Write bits. LSB & little-endian
  *        Note: No check. The pointer must be valid.
- * @param count Number of bits to be written (<= 64 bits, no length check)
+ * @param count Number of bits to be written
  * @param buf Data Buf
  */
-void DAP_SPI_WriteBits(const uint8_t count, const uint8_t *buf)
+void DAP_SPI_WriteBits(uint32_t count, const uint8_t *buf)
 {
     uint32_t data[16];
+    uint32_t n;
     int nbytes, i;
 
     DAP_SPI.user.usr_command = 0;
@@ -99,16 +118,23 @@ void DAP_SPI_WriteBits(const uint8_t count, const uint8_t *buf)
     // have data to send
     DAP_SPI.user.usr_mosi = 1;
     DAP_SPI.user.usr_miso = 0;
-    SET_MOSI_BIT_LEN(count - 1);
 
-    nbytes = div_round_up(count, 8);
-    memcpy(data, buf, nbytes);
+    while (count) {
+        n = (count > SPI_SEQUENCE_CHUNK_BITS) ? SPI_SEQUENCE_CHUNK_BITS : count;
+        SET_MOSI_BIT_LEN(n - 1);
 
-    for (i = 0; i < nbytes; i++) {
-        DAP_SPI.data_buf[i] = data[i];
-    }
+        nbytes = div_round_up(n, 8);
+        memcpy(data, buf, nbytes);
 
-    START_AND_WAIT_SPI_TRANSMISSION_DONE();
+        for (i = 0; i < div_round_up(nbytes, 4); i++) {
+            DAP_SPI.data_buf[i] = data[i];
+        }
+
+        START_AND_WAIT_SPI_TRANSMISSION_DONE();
+
+        buf += nbytes;
+        count -= n;
+    }
 }
 
 
@@ -116,14 +142,13 @@ void DAP_SPI_WriteBits(const uint8_t count, const uint8_t *buf)
 /**
  * @brief Read bits. LSB & little-endian
  *        Note: No check. The pointer must be valid.
- * @param count Number of bits to be read (<= 64 bits, no length check)
+ * @param count Number of bits to be read
  * @param buf Data Buf
  */
-void DAP_SPI_ReadBits(const uint8_t count, uint8_t *buf) {
-    int i;
-    uint32_t data_buf[2];
-
-    uint8_t * pData = (uint8_t *)data_buf;
+void DAP_SPI_ReadBits(uint32_t count, uint8_t *buf) {
+    int i, nbytes;
+    uint32_t n = 0;
+    uint32_t data_buf[16];
 
     DAP_SPI.user.usr_mosi = 0;
     DAP_SPI.user.usr_miso = 1;
@@ -132,24 +157,85 @@ void DAP_SPI_ReadBits(const uint8_t count, uint8_t *buf) {
     DAP_SPI.user.sio = true;
 #endif
 
-    SET_MISO_BIT_LEN(count - 1U);
+    while (count) {
+        n = (count > SPI_SEQUENCE_CHUNK_BITS) ? SPI_SEQUENCE_CHUNK_BITS : count;
+        SET_MISO_BIT_LEN(n - 1U);
 
-    START_AND_WAIT_SPI_TRANSMISSION_DONE();
+        START_AND_WAIT_SPI_TRANSMISSION_DONE();
+
+        nbytes = div_round_up(n, 8);
+        for (i = 0; i < div_round_up(nbytes, 4); i++) {
+            data_buf[i] = DAP_SPI.data_buf[i];
+        }
+        memcpy(buf, data_buf, nbytes);
+
+        buf += nbytes;
+        count -= n;
+    }
 
 #if (USE_SPI_SIO == 1)
     DAP_SPI.user.sio = false;
 #endif
 
-    data_buf[0] = DAP_SPI.data_buf[0];
-    data_buf[1] = DAP_SPI.data_buf[1];
+    // last byte use mask:
+    if (n % 8) {
+        buf[-1] &= (1U << (n % 8)) - 1U;
+    }
+}
+
+#if (USE_SPI_JTAG == 1) && !defined CONFIG_IDF_TARGET_ESP8266
+/**
+ * @brief Full duplex JTAG shift. LSB & little-endian
+ *        TMS is not touched, the caller sets it before the shift.
+ * @param count Number of TCK cycles
+ * @param tdi TDI data, NULL to shift out ones
+ * @param tdo TDO data, NULL if not captured
+ */
+void DAP_SPI_JTAG_Shift(uint32_t count, const uint8_t *tdi, uint8_t *tdo)
+{
+    uint32_t data[16];
+    uint32_t n = 0;
+    int nbytes, i;
 
-    for (i = 0; i < div_round_up(count, 8); i++)
-    {
-        buf[i] = pData[i];
+    DAP_SPI.user.usr_command = 0;
+    DAP_SPI.user.usr_addr = 0;
+    DAP_SPI.user.usr_mosi = 1;
+    DAP_SPI.user.usr_miso = (tdo != NULL);
+
+    while (count) {
+        n = (count > SPI_SEQUENCE_CHUNK_BITS) ? SPI_SEQUENCE_CHUNK_BITS : count;
+        SET_MOSI_BIT_LEN(n - 1U);
+        SET_MISO_BIT_LEN(n - 1U);
+
+        nbytes = div_round_up(n, 8);
+        if (tdi) {
+            memcpy(data, tdi, nbytes);
+            tdi += nbytes;
+        } else {
+            memset(data, 0xFF, nbytes);
+        }
+        for (i = 0; i < div_round_up(nbytes, 4); i++) {
+            DAP_SPI.data_buf[i] = data[i];
+        }
+
+        START_AND_WAIT_SPI_TRANSMISSION_DONE();
+
+        if (tdo) {
+            for (i = 0; i < div_round_up(nbytes, 4); i++) {
+                data[i] = DAP_SPI.data_buf[i];
+            }
+            memcpy(tdo, data, nbytes);
+            tdo += nbytes;
+        }
+        count -= n;
     }
+
     // last byte use mask:
-    buf[i-1] = buf[i-1] & ((2 >> (count % 8)) - 1);
+    if (tdo && (n % 8)) {
+        tdo[-1] &= (1U << (n % 8)) - 1U;
+    }
 }
+#endif
 
 #if defined CONFIG_IDF_TARGET_ESP8266 || defined CONFIG_IDF_TARGET_ESP32
 /**
@@ -224,6 +310,87 @@ __FORCEINLINE void DAP_SPI_Send_Header(const uint8_t packetHeaderData, uint8_t *
 #endif
 
 
+#if defined CONFIG_IDF_TARGET_ESP8266 || defined CONFIG_IDF_TARGET_ESP32
+/**
+ * @brief Packet request, ACK and read data phase in one transaction.
+ *        The data phase is always clocked, the caller has to check the ACK.
+ *
+ * @param packetHeaderData data from host
+ * @param ack ack from target
+ * @param resData data from target
+ * @param resParity parity from target
+ */
+__FORCEINLINE void DAP_SPI_Read_Fused(const uint8_t packetHeaderData, uint8_t *ack, uint32_t *resData, uint8_t *resParity)
+{
+    volatile uint64_t dataBuf;
+    uint32_t *pU32Data = (uint32_t *)&dataBuf;
+
+    DAP_SPI.user.usr_mosi = 1;
+    SET_MOSI_BIT_LEN(8 - 1);
+
+    DAP_SPI.user.usr_miso = 1;
+
+#if (USE_SPI_SIO == 1)
+    DAP_SPI.user.sio = true;
+#endif
+
+    // 1 bit Trn(Before ACK) + 3bits ACK + 32bits data + 1bit parity + 1 bit Trn(End) - 1(prescribed)
+    SET_MISO_BIT_LEN(1U + 3U + 32U + 1U + 1U - 1U);
+
+    DAP_SPI.data_buf[0] = packetHeaderData;
+
+    START_AND_WAIT_SPI_TRANSMISSION_DONE();
+
+#if (USE_SPI_SIO == 1)
+    DAP_SPI.user.sio = false;
+#endif
+
+    pU32Data[0] = DAP_SPI.data_buf[0];
+    pU32Data[1] = DAP_SPI.data_buf[1];
+
+    *ack = (dataBuf >> 1U) & 0b111;
+    *resData = (dataBuf >> (1U + 3U)) & 0xFFFFFFFFU;
+    *resParity = (dataBuf >> (1U + 3U + 32U)) & 1U;
+}
+#elif defined CONFIG_IDF_TARGET_ESP32C3 || defined CONFIG_IDF_TARGET_ESP32S3
+__FORCEINLINE void DAP_SPI_Read_Fused(const uint8_t packetHeaderData, uint8_t *ack, uint32_t *resData, uint8_t *resParity)
+{
+    volatile uint64_t dataBuf;
+    uint32_t *pU32Data = (uint32_t *)&dataBuf;
+
+    DAP_SPI.user.usr_mosi = 0;
+    DAP_SPI.user.usr_command = 1;
+    DAP_SPI.user.usr_miso = 1;
+
+    // 8bits Header + 1 bit Trn(Before ACK) - 1(prescribed)
+    DAP_SPI.user2.usr_command_bitlen = 8U + 1U - 1U;
+    DAP_SPI.user2.usr_command_value = packetHeaderData;
+
+#if (USE_SPI_SIO == 1)
+    DAP_SPI.user.sio = true;
+#endif
+
+    // 3bits ACK + 32bits data + 1bit parity + 1 bit Trn(End) - 1(prescribed)
+    SET_MISO_BIT_LEN(3U + 32U + 1U + 1U - 1U);
+
+    START_AND_WAIT_SPI_TRANSMISSION_DONE();
+
+#if (USE_SPI_SIO == 1)
+    DAP_SPI.user.sio = false;
+#endif
+
+    DAP_SPI.user.usr_command = 0;
+
+    pU32Data[0] = DAP_SPI.data_buf[0];
+    pU32Data[1] = DAP_SPI.data_buf[1];
+
+    *ack = dataBuf & 0b111;
+    *resData = (dataBuf >> 3U) & 0xFFFFFFFFU;
+    *resParity = (dataBuf >> (3U + 32U)) & 1U;
+}
+#endif
+
+
 /**
  * @brief Step2: Read Data
  *
@@ -295,6 +462,107 @@ __FORCEINLINE void DAP_SPI_Write_Data(uint32_t data, uint8_t parity)
 #endif
 
 
+/**
+ * @brief Step2: Write Data followed by idle cycles in one transaction
+ *
+ * @param data data from host
+ * @param parity parity from host
+ * @param idle number of idle cycles
+ */
+__FORCEINLINE void DAP_SPI_Write_Data_Idle(uint32_t data, uint8_t parity, uint8_t idle)
+{
+    int i, nbits, nwords;
+
+    DAP_SPI.user.usr_mosi = 1;
+    DAP_SPI.user.usr_miso = 0;
+
+#if defined CONFIG_IDF_TARGET_ESP32C3 || defined CONFIG_IDF_TARGET_ESP32S3
+    // keep the additional bit of DAP_SPI_Write_Data()
+    nbits = 32 + 1 + 1 + idle;
+#else
+    nbits = 32 + 1 + idle;
+#endif
+
+    SET_MOSI_BIT_LEN(nbits - 1U);
+    DAP_SPI.data_buf[0] = data;
+    DAP_SPI.data_buf[1] = parity & 1U;
+
+    nwords = div_round_up(nbits, 32);
+    for (i = 2; i < nwords; i++) {
+        DAP_SPI.data_buf[i] = 0x00000000U;
+    }
+
+    START_AND_WAIT_SPI_TRANSMISSION_DONE();
+}
+
+
+#if defined CONFIG_IDF_TARGET_ESP32C3 || defined CONFIG_IDF_TARGET_ESP32S3
+/**
+ * @brief Prepare posted writes: packet request, ACK, data phase and idle
+ *        cycles in one transaction. The ACK is not sampled, so the target
+ *        must have overrun detection enabled (a data phase always follows
+ *        WAIT/FAULT in that mode).
+ *
+ * @param idle number of idle cycles after each write
+ */
+__FORCEINLINE void DAP_SPI_Write_Posted_Begin(uint8_t idle)
+{
+    int i, nbits;
+
+    DAP_SPI.user.usr_command = 1;
+    DAP_SPI.user.usr_dummy = 1;
+    DAP_SPI.user.usr_mosi = 1;
+    DAP_SPI.user.usr_miso = 0;
+
+    // 8bits Header - 1(prescribed)
+    DAP_SPI.user2.usr_command_bitlen = 8U - 1U;
+
+    // 1 bit Trn + 3bits ACK + 1 bit Trn - 1(prescribed), the bus is not driven here
+    DAP_SPI.user1.usr_dummy_cyclelen = 1U + 3U + 1U - 1U;
+
+    // Same as DAP_SPI_Write_Data_Idle(): one additional bit for esp32c3
+    nbits = 32 + 1 + 1 + idle;
+    SET_MOSI_BIT_LEN(nbits - 1U);
+
+    for (i = 2; i < div_round_up(nbits, 32); i++) {
+        DAP_SPI.data_buf[i] = 0x00000000U;
+    }
+}
+
+/**
+ * @brief Posted write. Returns as soon as the transaction has been started,
+ *        so the caller can prepare the next word while the previous one is
+ *        still on the wire.
+ *
+ * @param packetHeaderData data from host
+ * @param data data from host
+ * @param parity parity from host
+ */
+__FORCEINLINE void DAP_SPI_Write_Posted(const uint8_t packetHeaderData, uint32_t data, uint8_t parity)
+{
+    WAIT_SPI_TRANSMISSION_DONE();
+
+    DAP_SPI.user2.usr_command_value = packetHeaderData;
+    DAP_SPI.data_buf[0] = data;
+    DAP_SPI.data_buf[1] = parity & 1U;
+
+    START_SPI_TRANSMISSION();
+}
+
+/**
+ * @brief Wait for the last posted write
+ *
+ */
+__FORCEINLINE void DAP_SPI_Write_Posted_End(void)
+{
+    WAIT_SPI_TRANSMISSION_DONE();
+
+    DAP_SPI.user.usr_command = 0;
+    DAP_SPI.user.usr_dummy = 0;
+}
+#endif
+
+
 #if defined CONFIG_IDF_TARGET_ESP8266 || defined CONFIG_IDF_TARGET_ESP32 || defined CONFIG_IDF_TARGET_ESP32S3
 /**
  * @brief Generate Clock Cycle
@@ -5,6 +5,7 @@
  * @change: 2020-11-25 first version
  *          2021-2-11 Transmission mode switching test passed
  *          2022-9-15 Support ESP32C3
+ *          2026-10-19 Route TDI/TDO to SPI for JTAG
  * @version 0.4
  * @date 2021-9-15
  *
@@ -15,6 +16,9 @@
 
 #include <stdbool.h>
 
+#include "main/dap_configuration.h"
+
+#include "components/DAP/config/DAP_config.h"
 #include "components/DAP/include/cmsis_compiler.h"
 #include "components/DAP/include/spi_switch.h"
 #include "components/DAP/include/gpio_common.h"
@@ -31,10 +35,16 @@
     #define FUNC_SPI 1
     #define SPI2_HOST 1
     #define SPI_LL_RST_MASK (SPI_OUT_RST | SPI_IN_RST | SPI_AHBM_RST | SPI_AHBM_FIFO_RST)
+    #define DAP_SPI_D_OUT_IDX HSPID_OUT_IDX
+    #define DAP_SPI_Q_IN_IDX  HSPIQ_IN_IDX
 #elif defined CONFIG_IDF_TARGET_ESP32C3
     #define DAP_SPI GPSPI2
+    #define DAP_SPI_D_OUT_IDX FSPID_OUT_IDX
+    #define DAP_SPI_Q_IN_IDX  FSPIQ_IN_IDX
 #elif defined CONFIG_IDF_TARGET_ESP32S3
     #define DAP_SPI GPSPI2
+    #define DAP_SPI_D_OUT_IDX FSPID_OUT_IDX
+    #define DAP_SPI_Q_IN_IDX  FSPIQ_IN_IDX
 #else
     #error unknown hardware
 #endif
@@ -579,3 +589,47 @@ __FORCEINLINE void DAP_SPI_Release()
     gpio_ll_iomux_func_sel(GPIO_PIN_MUX_REG[GPIO_NUM_12], FUNC_GPIO12_GPIO12);
 }
 #endif
+
+
+#if (USE_SPI_JTAG == 1) && !defined CONFIG_IDF_TARGET_ESP8266
+/**
+ * @brief Switch to SPI JTAG mode.
+ *        TCK stays on the SPI clock pin, TMS is switched back to GPIO,
+ *        TDI and TDO are routed to the SPI data lines through the GPIO matrix.
+ *
+ */
+void DAP_SPI_JTAG_Init()
+{
+    DAP_SPI_Init();
+
+    // SWDIO/TMS pin as GPIO, then take the clock back
+    DAP_SPI_Deinit();
+    DAP_SPI_Acquire();
+
+    // TDI from SPI MOSI
+    GPIO.func_out_sel_cfg[PIN_TDI].func_sel = DAP_SPI_D_OUT_IDX;
+    GPIO.func_out_sel_cfg[PIN_TDI].oen_sel = 1;  // keep the output enable of PORT_JTAG_SETUP()
+
+    // TDO to SPI MISO
+    GPIO.func_in_sel_cfg[DAP_SPI_Q_IN_IDX].func_sel = PIN_TDO;
+    GPIO.func_in_sel_cfg[DAP_SPI_Q_IN_IDX].sig_in_sel = 1;
+
+    // Full duplex transmit
+    DAP_SPI.user.doutdin = true;
+}
+
+
+/**
+ * @brief Leave SPI JTAG mode, all pins are GPIO afterwards.
+ *
+ */
+void DAP_SPI_JTAG_Deinit()
+{
+    DAP_SPI.user.doutdin = false;
+
+    GPIO.func_out_sel_cfg[PIN_TDI].func_sel = SIG_GPIO_OUT_IDX;
+    GPIO.func_out_sel_cfg[PIN_TDI].oen_sel = 1;
+
+    DAP_SPI_Deinit();
+}
+#endif
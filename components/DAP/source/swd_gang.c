@@ -0,0 +1,399 @@
+/**
+ * @file swd_gang.c
+ * @brief Drive several SWD buses in lockstep for gang programming
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * Every bus has its own SWCLK and SWDIO pin (see SWD_GANG_PINS in DAP_config.h).
+ * All buses are clocked together with the GPIO set/clear registers and sampled
+ * with a single read of the GPIO input register, so the same image is written
+ * to every target in the time one target would take. A bus that answers WAIT
+ * or FAULT simply gets no clocks for the rest of that transfer, and a failed
+ * bus is dropped for the rest of the command. Results are reported per bus.
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <string.h>
+
+#include "main/dap_configuration.h"
+
+#include "components/DAP/config/DAP_config.h"
+#include "components/DAP/include/DAP.h"
+#include "components/DAP/include/dap_utility.h"
+#include "components/DAP/include/debug_cm.h"
+#include "components/DAP/include/gpio_op.h"
+#include "components/DAP/include/mem_cache.h"
+#include "components/DAP/include/spi_switch.h"
+#include "components/DAP/include/swd_gang.h"
+#include "components/DAP/include/swd_host.h"
+
+#if (USE_SWD_GANG == 1) && (defined CONFIG_IDF_TARGET_ESP32 || defined CONFIG_IDF_TARGET_ESP32S3)
+
+typedef struct {
+  uint8_t swclk;
+  uint8_t swdio_out;
+  uint8_t swdio_in;
+} SWD_GangPins_t;
+
+static const SWD_GangPins_t kGangPins[SWD_GANG_BUS_CNT] = SWD_GANG_PINS;
+
+#define GANG_OUT_SET(mask)      (GPIO.out_w1ts = (mask))
+#define GANG_OUT_CLR(mask)      (GPIO.out_w1tc = (mask))
+#define GANG_OE_SET(mask)       (GPIO.enable_w1ts = (mask))
+#define GANG_OE_CLR(mask)       (GPIO.enable_w1tc = (mask))
+#define GANG_IN()               (GPIO.in)
+
+#define GANG_CSW_VALUE          (CSW_RESERVED | CSW_MSTRDBG | CSW_HPROT | CSW_DBGSTAT | CSW_SADDRINC | CSW_SIZE32)
+#define GANG_TAR_WRAP           1024U   // TAR auto-increment is only guaranteed within 1KB
+
+#define PIN_DELAY() PIN_DELAY_SLOW(DAP_Data.clock_delay)
+
+
+static uint32_t Gang_ClkMask(uint32_t buses) {
+  uint32_t mask = 0U;
+  uint32_t n;
+
+  for (n = 0U; n < SWD_GANG_BUS_CNT; n++) {
+    if (buses & (1U << n)) {
+      mask |= 1U << kGangPins[n].swclk;
+    }
+  }
+  return mask;
+}
+
+static uint32_t Gang_DioMask(uint32_t buses) {
+  uint32_t mask = 0U;
+  uint32_t n;
+
+  for (n = 0U; n < SWD_GANG_BUS_CNT; n++) {
+    if (buses & (1U << n)) {
+      mask |= 1U << kGangPins[n].swdio_out;
+    }
+  }
+  return mask;
+}
+
+// One SWCLK cycle on the selected buses, SWDIO is sampled before the rising edge
+//   clk:    SWCLK pin mask
+//   return: GPIO input register
+static uint32_t Gang_Cycle(uint32_t clk) {
+  uint32_t in;
+
+  GANG_OUT_CLR(clk);
+  PIN_DELAY();
+  in = GANG_IN();
+  GANG_OUT_SET(clk);
+  PIN_DELAY();
+  return in;
+}
+
+// Write bits that are the same on every bus
+static void Gang_WriteBits(uint32_t buses, uint32_t count, uint32_t val) {
+  const uint32_t clk = Gang_ClkMask(buses);
+  const uint32_t dio = Gang_DioMask(buses);
+
+  while (count--) {
+    if (val & 1U) {
+      GANG_OUT_SET(dio);
+    } else {
+      GANG_OUT_CLR(dio);
+    }
+    Gang_Cycle(clk);
+    val >>= 1;
+  }
+}
+
+// Read bits from every bus
+//   data:   per bus value, LSB first
+static void Gang_ReadBits(uint32_t buses, uint32_t count, uint32_t *data) {
+  const uint32_t clk = Gang_ClkMask(buses);
+  uint32_t in;
+  uint32_t bit, n;
+
+  for (n = 0U; n < SWD_GANG_BUS_CNT; n++) {
+    data[n] = 0U;
+  }
+  for (bit = 0U; bit < count; bit++) {
+    in = Gang_Cycle(clk);
+    for (n = 0U; n < SWD_GANG_BUS_CNT; n++) {
+      data[n] |= ((in >> kGangPins[n].swdio_in) & 1U) << bit;
+    }
+  }
+}
+
+static void Gang_Turnaround(uint32_t buses, uint32_t output) {
+  const uint32_t dio = Gang_DioMask(buses);
+
+  if (output == 0U) {
+    GANG_OE_CLR(dio);
+  }
+  Gang_Cycle(Gang_ClkMask(buses));
+  if (output) {
+    GANG_OE_SET(dio);
+  }
+}
+
+// Line reset with the JTAG-to-SWD switch sequence on every bus
+static void Gang_LineReset(uint32_t buses) {
+  Gang_WriteBits(buses, 32U, 0xFFFFFFFFU);
+  Gang_WriteBits(buses, 24U, 0x00FFFFFFU);
+  Gang_WriteBits(buses, 16U, 0xE79EU);      // JTAG-to-SWD
+  Gang_WriteBits(buses, 32U, 0xFFFFFFFFU);
+  Gang_WriteBits(buses, 24U, 0x00FFFFFFU);
+  Gang_WriteBits(buses, 8U, 0x00U);
+}
+
+// One SWD transfer on every selected bus, WAIT is retried on the waiting buses only
+//   buses:  bus mask
+//   request: A[3:2] RnW APnDP
+//   data:   per bus data to write or data read
+//   ack:    per bus ACK
+//   return: mask of buses that completed with OK
+static uint32_t Gang_Transfer(uint32_t buses, uint32_t request, uint32_t *data, uint8_t *ack) {
+  uint32_t header;
+  uint32_t acks[SWD_GANG_BUS_CNT];
+  uint32_t rdata[SWD_GANG_BUS_CNT];
+  uint32_t pending, ok, data_buses;
+  uint32_t retry, n, bit, in, clk, dio;
+
+  header = 0x81U | ((request & 0x0FU) << 1) | ((uint32_t)ParityEvenUint8(request & 0x0FU) << 5);
+  ok = 0U;
+  pending = buses;
+
+  for (retry = 0U; pending; retry++) {
+    Gang_WriteBits(pending, 8U, header);
+    Gang_Turnaround(pending, 0U);
+    Gang_ReadBits(pending, 3U, acks);
+
+    data_buses = 0U;
+    for (n = 0U; n < SWD_GANG_BUS_CNT; n++) {
+      if (pending & (1U << n)) {
+        ack[n] = (uint8_t)acks[n];
+        if (acks[n] == DAP_TRANSFER_OK) {
+          data_buses |= 1U << n;
+        }
+      }
+    }
+
+    if (data_buses && (request & DAP_TRANSFER_RnW)) {
+      Gang_ReadBits(data_buses, 32U, rdata);
+      Gang_ReadBits(data_buses, 1U, acks);
+      for (n = 0U; n < SWD_GANG_BUS_CNT; n++) {
+        if (data_buses & (1U << n)) {
+          if (((ParityEvenUint32(rdata[n]) ^ acks[n]) & 1U) != 0U) {
+            ack[n] = DAP_TRANSFER_ERROR;
+            data_buses &= ~(1U << n);
+          } else {
+            data[n] = rdata[n];
+          }
+        }
+      }
+    }
+    Gang_Turnaround(pending, 1U);
+
+    if (data_buses && !(request & DAP_TRANSFER_RnW)) {
+      // Different data on every bus, so set and clear per bit
+      clk = Gang_ClkMask(data_buses);
+      for (bit = 0U; bit < 33U; bit++) {
+        in = 0U;
+        dio = 0U;
+        for (n = 0U; n < SWD_GANG_BUS_CNT; n++) {
+          if (data_buses & (1U << n)) {
+            dio |= 1U << kGangPins[n].swdio_out;
+            if ((bit < 32U) ? ((data[n] >> bit) & 1U) : ParityEvenUint32(data[n])) {
+              in |= 1U << kGangPins[n].swdio_out;
+            }
+          }
+        }
+        GANG_OUT_SET(in);
+        GANG_OUT_CLR(dio & ~in);
+        Gang_Cycle(clk);
+      }
+    }
+
+    ok |= data_buses;
+    Gang_WriteBits(pending, DAP_Data.transfer.idle_cycles, 0U);
+
+    // Only buses that answered WAIT go around again
+    n = 0U;
+    for (bit = 0U; bit < SWD_GANG_BUS_CNT; bit++) {
+      if ((pending & (1U << bit)) && (ack[bit] == DAP_TRANSFER_WAIT)) {
+        n |= 1U << bit;
+      }
+    }
+    pending = (retry < DAP_Data.transfer.retry_count) ? n : 0U;
+  }
+
+  GANG_OUT_SET(Gang_DioMask(buses));
+  return ok;
+}
+
+// Take the pins, the first bus shares its pins with the normal SWD port
+static void Gang_Begin(void) {
+  uint32_t n;
+
+  if (SWD_TransferSpeed == kTransfer_SPI) {
+    DAP_SPI_Deinit();
+  }
+  for (n = 0U; n < SWD_GANG_BUS_CNT; n++) {
+    GPIO_FUNCTION_SET(kGangPins[n].swclk);
+    GPIO_SET_DIRECTION_NORMAL_OUT(kGangPins[n].swclk);
+    GPIO_SET_LEVEL_HIGH(kGangPins[n].swclk);
+    GPIO_FUNCTION_SET(kGangPins[n].swdio_out);
+    GPIO_SET_DIRECTION_NORMAL_OUT(kGangPins[n].swdio_out);
+    GPIO_SET_LEVEL_HIGH(kGangPins[n].swdio_out);
+#if defined CONFIG_IDF_TARGET_ESP32
+    PIN_INPUT_ENABLE(GPIO_PIN_MUX_REG[kGangPins[n].swdio_in]);
+#else
+    gpio_ll_input_enable(&GPIO, kGangPins[n].swdio_in);
+#endif
+  }
+}
+
+static void Gang_End(void) {
+  if (SWD_TransferSpeed == kTransfer_SPI) {
+    DAP_SPI_Init();
+  }
+  // DP SELECT of the first bus is no longer known, and its memory may have changed
+  SWD_InvalidateSelect();
+  swd_invalidate_dap_state();
+  mem_cache_flush();
+}
+
+
+static uint32_t get_u32(const uint8_t *p) {
+  return ((uint32_t)p[0] <<  0) |
+         ((uint32_t)p[1] <<  8) |
+         ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+  *p++ = (uint8_t)(v >>  0);
+  *p++ = (uint8_t)(v >>  8);
+  *p++ = (uint8_t)(v >> 16);
+  *p++ = (uint8_t)(v >> 24);
+  return p;
+}
+
+
+// Process Gang Transfer command and prepare response
+//   A failed bus is dropped for the remaining transfers, its read data is returned as 0.
+//   request:  [buses][count] followed by [request][data:32 for writes], SWD_GANG_LINE_RESET is a line reset
+//   response: [ok buses][ack per bus] followed by read data, one word per selected bus
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_SWD_GangTransfer(const uint8_t *request, uint8_t *response) {
+  const uint8_t *request_head = request;
+  uint8_t *p;
+  uint32_t data[SWD_GANG_BUS_CNT];
+  uint8_t  ack[SWD_GANG_BUS_CNT];
+  uint32_t buses, active, count, req, n;
+
+  buses = *request++ & ((1U << SWD_GANG_BUS_CNT) - 1U);
+  count = *request++;
+  active = buses;
+  memset(ack, DAP_TRANSFER_OK, sizeof(ack));
+  p = response + 1U + SWD_GANG_BUS_CNT;
+
+  Gang_Begin();
+  for (; count; count--) {
+    req = *request++;
+    if (req == SWD_GANG_LINE_RESET) {
+      Gang_LineReset(active);
+      continue;
+    }
+
+    if (!(req & DAP_TRANSFER_RnW)) {
+      for (n = 0U; n < SWD_GANG_BUS_CNT; n++) {
+        data[n] = get_u32(request);
+      }
+      request += 4U;
+    }
+    if (active) {
+      active = Gang_Transfer(active, req, data, ack);
+    }
+    if (req & DAP_TRANSFER_RnW) {
+      for (n = 0U; n < SWD_GANG_BUS_CNT; n++) {
+        if (buses & (1U << n)) {
+          p = put_u32(p, (active & (1U << n)) ? data[n] : 0U);
+        }
+      }
+    }
+  }
+  Gang_End();
+
+  response[0] = (uint8_t)active;
+  for (n = 0U; n < SWD_GANG_BUS_CNT; n++) {
+    response[1U + n] = ack[n];
+  }
+  return ((uint32_t)(request - request_head) << 16) | (uint32_t)(p - response);
+}
+
+// Process Gang Write Block command and prepare response
+//   The same words are written to memory on every bus through AP 0, which the host selected.
+//   request:  [buses][address:32][count:16] followed by count words
+//   response: [ok buses][ack per bus]
+//   return:   number of bytes in response (lower 16 bits)
+//             number of bytes in request (upper 16 bits)
+uint32_t DAP_SWD_GangWriteBlock(const uint8_t *request, uint8_t *response) {
+  uint32_t data[SWD_GANG_BUS_CNT];
+  uint8_t  ack[SWD_GANG_BUS_CNT];
+  uint32_t buses, active, address, count, word, n;
+
+  buses   = request[0] & ((1U << SWD_GANG_BUS_CNT) - 1U);
+  address = get_u32(request + 1U);
+  count   = (uint32_t)(request[5] | (request[6] << 8));
+  active  = buses;
+  memset(ack, DAP_TRANSFER_OK, sizeof(ack));
+
+  Gang_Begin();
+  for (n = 0U; n < SWD_GANG_BUS_CNT; n++) {
+    data[n] = GANG_CSW_VALUE;
+  }
+  active = Gang_Transfer(active, DAP_TRANSFER_APnDP | AP_CSW, data, ack);
+
+  for (word = 0U; active && (word < count); word++, address += 4U) {
+    if ((word == 0U) || ((address % GANG_TAR_WRAP) == 0U)) {
+      for (n = 0U; n < SWD_GANG_BUS_CNT; n++) {
+        data[n] = address;
+      }
+      active = Gang_Transfer(active, DAP_TRANSFER_APnDP | AP_TAR, data, ack);
+    }
+    for (n = 0U; n < SWD_GANG_BUS_CNT; n++) {
+      data[n] = get_u32(request + 7U + word * 4U);
+    }
+    active = Gang_Transfer(active, DAP_TRANSFER_APnDP | AP_DRW, data, ack);
+  }
+
+  // Posted writes complete with the RDBUFF read
+  if (active) {
+    active = Gang_Transfer(active, DP_RDBUFF | DAP_TRANSFER_RnW, data, ack);
+  }
+  Gang_End();
+
+  response[0] = (uint8_t)active;
+  for (n = 0U; n < SWD_GANG_BUS_CNT; n++) {
+    response[1U + n] = ack[n];
+  }
+  return ((7U + count * 4U) << 16) | (1U + SWD_GANG_BUS_CNT);
+}
+
+#else
+
+uint32_t DAP_SWD_GangTransfer(const uint8_t *request, uint8_t *response) {
+  (void)request;
+  *response = 0U;
+  return ((2U << 16) | 1U);
+}
+
+uint32_t DAP_SWD_GangWriteBlock(const uint8_t *request, uint8_t *response) {
+  uint32_t count = (uint32_t)(request[5] | (request[6] << 8));
+
+  *response = 0U;
+  return (((7U + count * 4U) << 16) | 1U);
+}
+
+#endif
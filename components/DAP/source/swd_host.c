@@ -22,11 +22,14 @@
  */
 
 #ifndef TARGET_MCU_CORTEX_A
+#include <string.h>
+
 #include "components/DAP/config/target_config.h"
 #include "components/DAP/config/DAP_config.h"
 #include "components/DAP/include/DAP.h"
 #include "components/DAP/include/target_family.h"
 #include "components/DAP/include/swd_host.h"
+#include "components/DAP/include/mem_cache.h"
 
 // Default NVIC and Core debug base addresses
 // TODO: Read these addresses from ROM.
@@ -35,6 +38,8 @@
 
 // AP CSW register, base value
 #define CSW_VALUE (CSW_RESERVED | CSW_MSTRDBG | CSW_HPROT | CSW_DBGSTAT | CSW_SADDRINC)
+// AP CSW register, base value for packed 8 and 16-bit transfers
+#define CSW_PACKED ((CSW_VALUE & ~CSW_ADDRINC) | CSW_PADDRINC)
 
 #define DCRDR 0xE000EDF8
 #define DCRSR 0xE000EDF4
@@ -53,6 +58,7 @@
 typedef struct {
     uint32_t select;
     uint32_t csw;
+    uint8_t packed;     // MEM-AP supports packed transfers, 0xff = not probed yet
 } DAP_STATE;
 
 typedef struct {
@@ -90,6 +96,21 @@ void swd_set_reset_connect(SWD_CONNECT_TYPE type)
     reset_connect = type;
 }
 
+void swd_set_target_reset(uint8_t asserted)
+{
+    mem_cache_flush();
+    PIN_nRESET_OUT(asserted ? 0U : 1U);
+}
+
+// Forget the cached SELECT and CSW values, the host may have changed them
+// through DAP_Transfer.
+void swd_invalidate_dap_state(void)
+{
+    dap_state.select = 0xffffffff;
+    dap_state.csw = 0xffffffff;
+    dap_state.packed = 0xff;
+}
+
 void int2array(uint8_t *res, uint32_t data, uint8_t len)
 {
     uint8_t i = 0;
@@ -127,6 +148,8 @@ uint8_t swd_init(void)
     //       and fixed.
     DAP_Setup();
     PORT_SWD_SETUP();
+    // DAP_Setup restored the default clock, which is a GPIO clock
+    SWD_TransferSpeed = kTransfer_GPIO_normal;
     return 1;
 }
 
@@ -254,8 +277,8 @@ uint8_t swd_write_ap(uint32_t adr, uint32_t val)
 
 
 // Write 32-bit word aligned values to target memory using address auto-increment.
-// size is in bytes.
-static uint8_t swd_write_block(uint32_t address, uint8_t *data, uint32_t size)
+// size is in bytes, csw selects the access size (packed for 8 and 16-bit).
+static uint8_t swd_write_block(uint32_t address, uint8_t *data, uint32_t size, uint32_t csw)
 {
     uint8_t tmp_in[4], req;
     uint32_t size_in_words;
@@ -268,7 +291,7 @@ static uint8_t swd_write_block(uint32_t address, uint8_t *data, uint32_t size)
     size_in_words = size / 4;
 
     // CSW register
-    if (!swd_write_ap(AP_CSW, CSW_VALUE | CSW_SIZE32)) {
+    if (!swd_write_ap(AP_CSW, csw)) {
         return 0;
     }
 
@@ -283,6 +306,11 @@ static uint8_t swd_write_block(uint32_t address, uint8_t *data, uint32_t size)
     // DRW write
     req = SWD_REG_AP | SWD_REG_W | (3 << 2);
 
+    // posted writes with overrun detection, this also checks the last write
+    if (SWD_TransferStream(req, data, size_in_words) == DAP_TRANSFER_OK) {
+        return 1;
+    }
+
     for (i = 0; i < size_in_words; i++) {
         if (swd_transfer_retry(req, (uint32_t *)data) != 0x01) {
             return 0;
@@ -298,8 +326,8 @@ static uint8_t swd_write_block(uint32_t address, uint8_t *data, uint32_t size)
 }
 
 // Read 32-bit word aligned values from target memory using address auto-increment.
-// size is in bytes.
-static uint8_t swd_read_block(uint32_t address, uint8_t *data, uint32_t size)
+// size is in bytes, csw selects the access size (packed for 8 and 16-bit).
+static uint8_t swd_read_block(uint32_t address, uint8_t *data, uint32_t size, uint32_t csw)
 {
     uint8_t tmp_in[4], req, ack;
     uint32_t size_in_words;
@@ -311,7 +339,7 @@ static uint8_t swd_read_block(uint32_t address, uint8_t *data, uint32_t size)
 
     size_in_words = size / 4;
 
-    if (!swd_write_ap(AP_CSW, CSW_VALUE | CSW_SIZE32)) {
+    if (!swd_write_ap(AP_CSW, csw)) {
         return 0;
     }
 
@@ -426,6 +454,8 @@ uint8_t swd_read_word(uint32_t addr, uint32_t *val)
 // Write 32-bit word to target memory.
 uint8_t swd_write_word(uint32_t addr, uint32_t val)
 {
+    mem_cache_invalidate(addr, 4);
+
     if (!swd_write_ap(AP_CSW, CSW_VALUE | CSW_SIZE32)) {
         return 0;
     }
@@ -459,6 +489,8 @@ uint8_t swd_write_byte(uint32_t addr, uint8_t val)
 {
     uint32_t tmp;
 
+    mem_cache_invalidate(addr, 1);
+
     if (!swd_write_ap(AP_CSW, CSW_VALUE | CSW_SIZE8)) {
         return 0;
     }
@@ -472,23 +504,220 @@ uint8_t swd_write_byte(uint32_t addr, uint8_t val)
     return 1;
 }
 
+// Read 16-bit halfword from target memory.
+uint8_t swd_read_halfword(uint32_t addr, uint16_t *val)
+{
+    uint32_t tmp;
+
+    if (!swd_write_ap(AP_CSW, CSW_VALUE | CSW_SIZE16)) {
+        return 0;
+    }
+
+    if (!swd_read_data(addr, &tmp)) {
+        return 0;
+    }
+
+    *val = (uint16_t)(tmp >> ((addr & 0x02) << 3));
+    return 1;
+}
+
+// Write 16-bit halfword to target memory.
+uint8_t swd_write_halfword(uint32_t addr, uint16_t val)
+{
+    uint32_t tmp;
+
+    mem_cache_invalidate(addr, 2);
+
+    if (!swd_write_ap(AP_CSW, CSW_VALUE | CSW_SIZE16)) {
+        return 0;
+    }
+
+    tmp = val << ((addr & 0x02) << 3);
+
+    if (!swd_write_data(addr, tmp)) {
+        return 0;
+    }
+
+    return 1;
+}
+
+// Transfer 8 or 16-bit items with one TAR write, the address auto-increments.
+// Every item sits in the byte lanes of its address. The items must not cross an
+// auto increment page.
+static uint8_t swd_transfer_items(uint32_t address, uint8_t *data, uint32_t size, uint32_t width, uint8_t write)
+{
+    uint8_t tmp[4], req;
+    uint32_t i, n, val;
+
+    n = size / width;
+
+    if (!swd_write_ap(AP_CSW, CSW_VALUE | ((width == 2) ? CSW_SIZE16 : CSW_SIZE8))) {
+        return 0;
+    }
+
+    // TAR write
+    req = SWD_REG_AP | SWD_REG_W | AP_TAR;
+    int2array(tmp, address, 4);
+
+    if (swd_transfer_retry(req, (uint32_t *)tmp) != 0x01) {
+        return 0;
+    }
+
+    if (write) {
+        req = SWD_REG_AP | SWD_REG_W | AP_DRW;
+
+        for (i = 0; i < n; i++, address += width, data += width) {
+            val = (width == 2) ? (data[0] | (data[1] << 8)) : data[0];
+            int2array(tmp, val << ((address & 0x03) << 3), 4);
+
+            if (swd_transfer_retry(req, (uint32_t *)tmp) != 0x01) {
+                return 0;
+            }
+        }
+
+        // dummy read
+        req = SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF);
+        return (swd_transfer_retry(req, NULL) == 0x01);
+    }
+
+    // initiate first read, data comes back in next read
+    req = SWD_REG_AP | SWD_REG_R | AP_DRW;
+
+    if (swd_transfer_retry(req, NULL) != 0x01) {
+        return 0;
+    }
+
+    for (i = 0; i < n; i++, address += width, data += width) {
+        // the last item comes from RDBUFF
+        if (i == n - 1) {
+            req = SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF);
+        }
+
+        if (swd_transfer_retry(req, (uint32_t *)tmp) != 0x01) {
+            return 0;
+        }
+
+        val = (uint32_t)tmp[0] | ((uint32_t)tmp[1] << 8) | ((uint32_t)tmp[2] << 16) | ((uint32_t)tmp[3] << 24);
+        val >>= (address & 0x03) << 3;
+        data[0] = (uint8_t)val;
+
+        if (width == 2) {
+            data[1] = (uint8_t)(val >> 8);
+        }
+    }
+
+    return 1;
+}
+
+// Transfer less than a word within one word: one halfword access when it is
+// aligned, otherwise a run of byte accesses.
+static uint8_t swd_transfer_sub(uint32_t address, uint8_t *data, uint32_t size, uint8_t write)
+{
+    return swd_transfer_items(address, data, size, ((address | size) & 1) ? 1 : 2, write);
+}
+
+// Packed transfers are optional in a MEM-AP. Without them the AddrInc field
+// does not read back as packed.
+static uint8_t swd_packed_supported(void)
+{
+    uint32_t csw;
+
+    if (dap_state.packed == 0xff) {
+        dap_state.packed = 0;
+
+        if (swd_write_ap(AP_CSW, CSW_PACKED | CSW_SIZE8) && swd_read_ap(AP_CSW, &csw)) {
+            dap_state.packed = ((csw & CSW_ADDRINC) == CSW_PADDRINC);
+        }
+
+        // CSW holds whatever the AP accepted
+        dap_state.csw = 0xffffffff;
+    }
+
+    return dap_state.packed;
+}
+
+// Transfer 8 or 16-bit items. Word aligned runs go as packed transfers, four
+// bytes per DRW access, on a MEM-AP that supports them.
+static uint8_t swd_transfer_width(uint32_t address, uint8_t *data, uint32_t size, uint32_t width, uint8_t write)
+{
+    uint32_t n, csw;
+    uint8_t packed, ok;
+
+    if (((width != 1) && (width != 2)) || ((address | size) & (width - 1))) {
+        return 0;
+    }
+
+    csw = CSW_PACKED | ((width == 2) ? CSW_SIZE16 : CSW_SIZE8);
+    packed = (size >= 4) && swd_packed_supported();
+
+    while (size > 0) {
+        // Limit to auto increment page size
+        n = TARGET_AUTO_INCREMENT_PAGE_SIZE - (address & (TARGET_AUTO_INCREMENT_PAGE_SIZE - 1));
+
+        if (size < n) {
+            n = size;
+        }
+
+        if (packed && !(address & 0x03) && (n >= 4)) {
+            n &= 0xFFFFFFFC;
+            ok = write ? swd_write_block(address, data, n, csw) : swd_read_block(address, data, n, csw);
+        } else {
+            // Single items up to the word boundary, the rest is packed
+            if (packed && (address & 0x03) && (n > 4 - (address & 0x03))) {
+                n = 4 - (address & 0x03);
+            }
+
+            ok = swd_transfer_items(address, data, n, width, write);
+        }
+
+        if (!ok) {
+            return 0;
+        }
+
+        address += n;
+        data += n;
+        size -= n;
+    }
+
+    return 1;
+}
+
+// Read 8 or 16-bit items from target memory, each with an access of that width.
+// address and size are multiples of width.
+uint8_t swd_read_memory_width(uint32_t address, uint8_t *data, uint32_t size, uint32_t width)
+{
+    return swd_transfer_width(address, data, size, width, 0);
+}
+
+// Write 8 or 16-bit items to target memory, each with an access of that width.
+// address and size are multiples of width.
+uint8_t swd_write_memory_width(uint32_t address, uint8_t *data, uint32_t size, uint32_t width)
+{
+    mem_cache_invalidate(address, size);
+    return swd_transfer_width(address, data, size, width, 1);
+}
+
 // Read unaligned data from target memory.
 // size is in bytes.
-uint8_t swd_read_memory(uint32_t address, uint8_t *data, uint32_t size)
+static uint8_t swd_read_memory_uncached(uint32_t address, uint8_t *data, uint32_t size)
 {
     uint32_t n;
 
-    // Read bytes until word aligned
-    while ((size > 0) && (address & 0x3)) {
-        if (!swd_read_byte(address, data)) {
-            return 0;
-        }
+    // Read up to the word boundary
+    n = (4 - (address & 0x3)) & 0x3;
 
-        address++;
-        data++;
-        size--;
+    if (n > size) {
+        n = size;
     }
 
+    if (n && !swd_transfer_sub(address, data, n, 0)) {
+        return 0;
+    }
+
+    address += n;
+    data += n;
+    size -= n;
+
     // Read word aligned blocks
     while (size > 3) {
         // Limit to auto increment page size
@@ -498,7 +727,7 @@ uint8_t swd_read_memory(uint32_t address, uint8_t *data, uint32_t size)
             n = size & 0xFFFFFFFC; // Only count complete words remaining
         }
 
-        if (!swd_read_block(address, data, n)) {
+        if (!swd_read_block(address, data, n, CSW_VALUE | CSW_SIZE32)) {
             return 0;
         }
 
@@ -508,36 +737,43 @@ uint8_t swd_read_memory(uint32_t address, uint8_t *data, uint32_t size)
     }
 
     // Read remaining bytes
-    while (size > 0) {
-        if (!swd_read_byte(address, data)) {
-            return 0;
-        }
-
-        address++;
-        data++;
-        size--;
+    if (size && !swd_transfer_sub(address, data, size, 0)) {
+        return 0;
     }
 
     return 1;
 }
 
+// Read unaligned data from target memory, through the cache of read-only ranges.
+// size is in bytes.
+uint8_t swd_read_memory(uint32_t address, uint8_t *data, uint32_t size)
+{
+    return mem_cache_read(address, data, size, swd_read_memory_uncached);
+}
+
 // Write unaligned data to target memory.
 // size is in bytes.
 uint8_t swd_write_memory(uint32_t address, uint8_t *data, uint32_t size)
 {
     uint32_t n = 0;
 
-    // Write bytes until word aligned
-    while ((size > 0) && (address & 0x3)) {
-        if (!swd_write_byte(address, *data)) {
-            return 0;
-        }
+    mem_cache_invalidate(address, size);
+
+    // Write up to the word boundary
+    n = (4 - (address & 0x3)) & 0x3;
+
+    if (n > size) {
+        n = size;
+    }
 
-        address++;
-        data++;
-        size--;
+    if (n && !swd_transfer_sub(address, data, n, 1)) {
+        return 0;
     }
 
+    address += n;
+    data += n;
+    size -= n;
+
     // Write word aligned blocks
     while (size > 3) {
         // Limit to auto increment page size
@@ -547,7 +783,7 @@ uint8_t swd_write_memory(uint32_t address, uint8_t *data, uint32_t size)
             n = size & 0xFFFFFFFC; // Only count complete words remaining
         }
 
-        if (!swd_write_block(address, data, n)) {
+        if (!swd_write_block(address, data, n, CSW_VALUE | CSW_SIZE32)) {
             return 0;
         }
 
@@ -557,14 +793,8 @@ uint8_t swd_write_memory(uint32_t address, uint8_t *data, uint32_t size)
     }
 
     // Write remaining bytes
-    while (size > 0) {
-        if (!swd_write_byte(address, *data)) {
-            return 0;
-        }
-
-        address++;
-        data++;
-        size--;
+    if (size && !swd_transfer_sub(address, data, size, 1)) {
+        return 0;
     }
 
     return 1;
@@ -573,33 +803,23 @@ uint8_t swd_write_memory(uint32_t address, uint8_t *data, uint32_t size)
 // Execute system call.
 static uint8_t swd_write_debug_state(DEBUG_STATE *state)
 {
-    uint32_t i, status;
+    // R0, R1, R2, R3, R9, R13, R14, R15, xPSR
+    static const uint8_t regsel[] = {0, 1, 2, 3, 9, 13, 14, 15, 16};
+    uint32_t val[sizeof(regsel)];
+    uint32_t status;
 
     if (!swd_write_dp(DP_SELECT, 0)) {
         return 0;
     }
 
-    // R0, R1, R2, R3
-    for (i = 0; i < 4; i++) {
-        if (!swd_write_core_register(i, state->r[i])) {
-            return 0;
-        }
-    }
+    memcpy(val, state->r, 4 * sizeof(uint32_t));
+    val[4] = state->r[9];
+    val[5] = state->r[13];
+    val[6] = state->r[14];
+    val[7] = state->r[15];
+    val[8] = state->xpsr;
 
-    // R9
-    if (!swd_write_core_register(9, state->r[9])) {
-        return 0;
-    }
-
-    // R13, R14, R15
-    for (i = 13; i < 16; i++) {
-        if (!swd_write_core_register(i, state->r[i])) {
-            return 0;
-        }
-    }
-
-    // xPSR
-    if (!swd_write_core_register(16, state->xpsr)) {
+    if (!swd_write_core_registers(regsel, val, sizeof(regsel))) {
         return 0;
     }
 
@@ -679,6 +899,149 @@ uint8_t swd_write_core_register(uint32_t n, uint32_t val)
     return 0;
 }
 
+// Core register transfers through the banked data registers. With TAR at DHCSR,
+// BD0 is DHCSR, BD1 is DCRSR and BD2 is DCRDR, so every register takes three
+// transfers and no TAR write. DHCSR is read before every DCRDR access and
+// S_REGRDY is checked afterwards, a core that was not ready in time goes
+// through the polled path.
+static uint8_t swd_core_bank_begin(void)
+{
+    uint8_t tmp_in[4], req;
+
+    if (!swd_write_ap(AP_CSW, CSW_VALUE | CSW_SIZE32)) {
+        return 0;
+    }
+
+    // TAR write
+    req = SWD_REG_AP | SWD_REG_W | AP_TAR;
+    int2array(tmp_in, DHCSR, 4);
+
+    if (swd_transfer_retry(req, (uint32_t *)tmp_in) != 0x01) {
+        return 0;
+    }
+
+    return swd_write_dp(DP_SELECT, swd_get_apsel(AP_BD0) | (AP_BD0 & APBANKSEL));
+}
+
+static uint32_t array2int(const uint8_t *data)
+{
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+// Read several core registers, regsel holds the DCRSR register numbers.
+uint8_t swd_read_core_registers(const uint8_t *regsel, uint32_t count, uint32_t *val)
+{
+    uint8_t tmp[4], ready = 1;
+    uint32_t i;
+
+    if (count == 0) {
+        return 1;
+    }
+
+    if (!swd_core_bank_begin()) {
+        return 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        int2array(tmp, regsel[i], 4);
+
+        if (swd_transfer_retry(SWD_REG_AP | SWD_REG_W | SWD_REG_ADR(AP_BD1), (uint32_t *)tmp) != 0x01) {
+            return 0;
+        }
+
+        // AP reads are posted: BD0 returns the previous DCRDR, BD2 this DHCSR
+        if (swd_transfer_retry(SWD_REG_AP | SWD_REG_R | SWD_REG_ADR(AP_BD0), (uint32_t *)tmp) != 0x01) {
+            return 0;
+        }
+
+        if (i > 0) {
+            val[i - 1] = array2int(tmp);
+        }
+
+        if (swd_transfer_retry(SWD_REG_AP | SWD_REG_R | SWD_REG_ADR(AP_BD2), (uint32_t *)tmp) != 0x01) {
+            return 0;
+        }
+
+        if (!(array2int(tmp) & S_REGRDY)) {
+            ready = 0;
+        }
+    }
+
+    // read last DCRDR
+    if (swd_transfer_retry(SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF), (uint32_t *)tmp) != 0x01) {
+        return 0;
+    }
+
+    val[count - 1] = array2int(tmp);
+
+    if (!ready) {
+        for (i = 0; i < count; i++) {
+            if (!swd_read_core_register(regsel[i], &val[i])) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+// Write several core registers, regsel holds the DCRSR register numbers.
+uint8_t swd_write_core_registers(const uint8_t *regsel, const uint32_t *val, uint32_t count)
+{
+    uint8_t tmp[4], ready = 1;
+    uint32_t i;
+
+    if (count == 0) {
+        return 1;
+    }
+
+    if (!swd_core_bank_begin()) {
+        return 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        int2array(tmp, val[i], 4);
+
+        if (swd_transfer_retry(SWD_REG_AP | SWD_REG_W | SWD_REG_ADR(AP_BD2), (uint32_t *)tmp) != 0x01) {
+            return 0;
+        }
+
+        int2array(tmp, regsel[i] | REGWnR, 4);
+
+        if (swd_transfer_retry(SWD_REG_AP | SWD_REG_W | SWD_REG_ADR(AP_BD1), (uint32_t *)tmp) != 0x01) {
+            return 0;
+        }
+
+        // AP reads are posted: BD0 returns the DHCSR of the previous register
+        if (swd_transfer_retry(SWD_REG_AP | SWD_REG_R | SWD_REG_ADR(AP_BD0), (uint32_t *)tmp) != 0x01) {
+            return 0;
+        }
+
+        if ((i > 0) && !(array2int(tmp) & S_REGRDY)) {
+            ready = 0;
+        }
+    }
+
+    // read last DHCSR
+    if (swd_transfer_retry(SWD_REG_DP | SWD_REG_R | SWD_REG_ADR(DP_RDBUFF), (uint32_t *)tmp) != 0x01) {
+        return 0;
+    }
+
+    if (!(array2int(tmp) & S_REGRDY)) {
+        ready = 0;
+    }
+
+    if (!ready) {
+        for (i = 0; i < count; i++) {
+            if (!swd_write_core_register(regsel[i], val[i])) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
 static uint8_t swd_wait_until_halted(void)
 {
     // Wait for target to stop
@@ -697,10 +1060,15 @@ static uint8_t swd_wait_until_halted(void)
     return 0;
 }
 
-uint8_t swd_flash_syscall_exec(const program_syscall_t *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, flash_algo_return_t return_type)
+// Start a flash algorithm function, the target runs until it hits the breakpoint
+uint8_t swd_flash_syscall_start(const program_syscall_t *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4)
 {
     DEBUG_STATE state = {{0}, 0};
-    // Call flash algorithm function on target and wait for result.
+
+    // The function may change the flash
+    mem_cache_flush();
+
+    // Call flash algorithm function on target
     state.r[0]     = arg1;                   // R0: Argument 1
     state.r[1]     = arg2;                   // R1: Argument 2
     state.r[2]     = arg3;                   // R2: Argument 3
@@ -711,15 +1079,17 @@ uint8_t swd_flash_syscall_exec(const program_syscall_t *sysCallParam, uint32_t e
     state.r[15]    = entry;                        // PC: Entry Point
     state.xpsr     = 0x01000000;          // xPSR: T = 1, ISR = 0
 
-    if (!swd_write_debug_state(&state)) {
-        return 0;
-    }
+    return swd_write_debug_state(&state);
+}
 
+// Wait for a function started with swd_flash_syscall_start and read its return value.
+uint8_t swd_flash_syscall_result(uint32_t *r0)
+{
     if (!swd_wait_until_halted()) {
         return 0;
     }
 
-    if (!swd_read_core_register(0, &state.r[0])) {
+    if (!swd_read_core_register(0, r0)) {
         return 0;
     }
 
@@ -728,15 +1098,28 @@ uint8_t swd_flash_syscall_exec(const program_syscall_t *sysCallParam, uint32_t e
         return 0;
     }
 
+    return 1;
+}
+
+// Wait for a flash algorithm function started with swd_flash_syscall_start and check its result.
+// Memory may be accessed in between, e.g. to fill the next program buffer.
+uint8_t swd_flash_syscall_wait(uint32_t arg1, uint32_t arg2, flash_algo_return_t return_type)
+{
+    uint32_t r0;
+
+    if (!swd_flash_syscall_result(&r0)) {
+        return 0;
+    }
+
     if ( return_type == FLASHALGO_RETURN_POINTER ) {
         // Flash verify functions return pointer to byte following the buffer if successful.
-        if (state.r[0] != (arg1 + arg2)) {
+        if (r0 != (arg1 + arg2)) {
             return 0;
         }
     }
     else {
         // Flash functions return 0 if successful.
-        if (state.r[0] != 0) {
+        if (r0 != 0) {
             return 0;
         }
     }
@@ -744,6 +1127,16 @@ uint8_t swd_flash_syscall_exec(const program_syscall_t *sysCallParam, uint32_t e
     return 1;
 }
 
+uint8_t swd_flash_syscall_exec(const program_syscall_t *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, flash_algo_return_t return_type)
+{
+    // Call flash algorithm function on target and wait for result.
+    if (!swd_flash_syscall_start(sysCallParam, entry, arg1, arg2, arg3, arg4)) {
+        return 0;
+    }
+
+    return swd_flash_syscall_wait(arg1, arg2, return_type);
+}
+
 // SWD Reset
 static uint8_t swd_reset(void)
 {
@@ -785,6 +1178,62 @@ static uint8_t swd_read_idcode(uint32_t *id)
 }
 
 
+// Selection alert sequence, shared by all dormant state wakeups
+static const uint8_t swd_selection_alert[16] = {
+    0x92, 0xf3, 0x09, 0x62, 0x95, 0x2d, 0x85, 0x86,
+    0xe9, 0xaf, 0xdd, 0xe3, 0xa2, 0x0e, 0xbc, 0x19,
+};
+
+// Leave dormant state: at least 8 cycles high, selection alert,
+// 4 cycles low and the 8 bit activation code.
+static uint8_t swd_dormant_wakeup(uint8_t activation_code)
+{
+    uint8_t tmp_in[1];
+
+    tmp_in[0] = 0xff;
+    SWJ_Sequence(8, tmp_in);
+    SWJ_Sequence(128, swd_selection_alert);
+
+    tmp_in[0] = 0x00;
+    SWJ_Sequence(4, tmp_in);
+    tmp_in[0] = activation_code;
+    SWJ_Sequence(8, tmp_in);
+    return 1;
+}
+
+uint8_t DORMANT2SWD()
+{
+    uint32_t tmp = 0;
+
+    if (!swd_dormant_wakeup(0x1A)) {
+        return 0;
+    }
+
+    if (!swd_reset()) {
+        return 0;
+    }
+
+    if (!swd_read_idcode(&tmp)) {
+        return 0;
+    }
+
+    return 1;
+}
+
+uint8_t DORMANT2JTAG()
+{
+    uint8_t tmp_in[1];
+
+    if (!swd_dormant_wakeup(0x0A)) {
+        return 0;
+    }
+
+    // Test-Logic-Reset, then Run-Test/Idle
+    tmp_in[0] = 0x1f;
+    SWJ_Sequence(6, tmp_in);
+    return 1;
+}
+
 uint8_t JTAG2SWD()
 {
     uint32_t tmp = 0;
@@ -802,7 +1251,8 @@ uint8_t JTAG2SWD()
     }
 
     if (!swd_read_idcode(&tmp)) {
-        return 0;
+        // SWJ-DP v2 targets may be in dormant state
+        return DORMANT2SWD();
     }
 
     return 1;
@@ -813,9 +1263,12 @@ uint8_t swd_init_debug(void)
     uint32_t tmp = 0;
     int i = 0;
     int timeout = 100;
+
+    mem_cache_flush();
     // init dap state with fake values
     dap_state.select = 0xffffffff;
     dap_state.csw = 0xffffffff;
+    dap_state.packed = 0xff;
 
     int8_t retries = 4;
     int8_t do_abort = 0;
@@ -907,6 +1360,8 @@ uint8_t swd_set_target_state_hw(target_state_t state)
 {
     uint32_t val;
     int8_t ap_retries = 2;
+    mem_cache_flush();
+
     /* Calling swd_init prior to entering RUN state causes operations to fail. */
     if (state != RUN) {
         swd_init();
@@ -1048,6 +1503,8 @@ uint8_t swd_set_target_state_sw(target_state_t state)
 {
     uint32_t val;
     int8_t ap_retries = 2;
+    mem_cache_flush();
+
     /* Calling swd_init prior to enterring RUN state causes operations to fail. */
     if (state != RUN) {
         swd_init();
@@ -0,0 +1,110 @@
+/**
+ * @file target_stub.c
+ * @brief Small built-in routines that run on a halted Cortex-M target
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * Checking a region over SWD means reading all of it. These routines run on the
+ * target CPU instead and only their result is read back. They are Thumb-1 code,
+ * so they also run on Cortex-M0, and position independent, so the host picks
+ * any word aligned TARGET_STUB_WORKSPACE bytes of target RAM.
+ *
+ * The call goes through swd_flash_syscall_start like a flash algorithm. The
+ * core registers are saved before and restored after, so a debug session that
+ * halted the core is not disturbed, apart from the workspace RAM.
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <string.h>
+
+#include "components/DAP/include/debug_cm.h"
+#include "components/DAP/include/flash_blob.h"
+#include "components/DAP/include/swd_host.h"
+#include "components/DAP/include/target_stub.h"
+
+// Default core debug base address
+#define DBG_Addr     (0xe000edf0)
+
+// R0 to R15 and xPSR
+#define TARGET_STUB_REGS    17U
+
+// crc32:   r0 = address, r1 = size, r2 = initial CRC   -> r0 = CRC, nibble table at 0x68
+//   0x00:  mvns r2, r2; adr r3, table; movs r6, #0x3c; cmp r1, #0; beq 2f
+//   0x0A:  1: ldrb r4, [r0]; adds r0, #1; eors r2, r4
+//          2x (lsls r4, r2, #2; ands r4, r6; ldr r4, [r3, r4]; lsrs r2, r2, #4; eors r2, r4)
+//          subs r1, #1; bne 1b
+//   0x28:  2: mvns r0, r2; bx lr
+// fill:    r0 = address, r1 = size, r2 = byte          -> r0 = 0
+//   0x2C:  cmp r1, #0; beq 2f; 1: strb r2, [r0]; adds r0, #1; subs r1, #1; bne 1b
+//          2: movs r0, #0; bx lr
+// compare: r0 = address, r1 = size, r2 = second address -> r0 = offset of the first difference
+//   0x3C:  movs r3, #0; 1: cmp r3, r1; beq 2f; ldrb r4, [r0, r3]; ldrb r5, [r2, r3]
+//          cmp r4, r5; bne 2f; adds r3, #1; b 1b; 2: movs r0, r3; bx lr
+// blank:   r0 = address, r1 = size, r2 = erased byte   -> r0 = offset of the first other byte
+//   0x52:  movs r3, #0; 1: cmp r3, r1; beq 2f; ldrb r4, [r0, r3]
+//          cmp r4, r2; bne 2f; adds r3, #1; b 1b; 2: movs r0, r3; bx lr
+// 0x66:    bkpt #0, the return address of every routine
+static const uint32_t kStubBlob[] = {
+    0xA31943D2, 0x2900263C, 0x7804D00E, 0x40623001, 0x40340094, 0x0912591C,
+    0x00944062, 0x591C4034, 0x40620912, 0xD1F03901, 0x477043D0, 0xD0032900,
+    0x30017002, 0xD1FB3901, 0x47702000, 0x428B2300, 0x5CC4D005, 0x42AC5CD5,
+    0x3301D101, 0x0018E7F7, 0x23004770, 0xD004428B, 0x42945CC4, 0x3301D101,
+    0x0018E7F8, 0xBE004770, 0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344,
+    0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+static const uint8_t kStubEntry[TARGET_STUB_COUNT] = {0x00U, 0x2CU, 0x3CU, 0x52U};
+
+static const uint8_t kStubRegs[TARGET_STUB_REGS] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+
+#define TARGET_STUB_BREAKPOINT  0x66U
+
+// Run a routine on the target
+//   function:  TARGET_STUB_*
+//   workspace: word aligned target RAM for the code and the stack
+//   result:    value returned by the routine
+//   return:    1 on success, 0 when the core is not halted or the routine did not finish
+uint8_t target_stub_run(uint32_t function, uint32_t workspace, uint32_t address,
+                        uint32_t size, uint32_t arg, uint32_t *result)
+{
+    program_syscall_t sys_call;
+    uint32_t regs[TARGET_STUB_REGS];
+    uint32_t val;
+    uint8_t ok;
+
+    if (function >= TARGET_STUB_COUNT || (workspace & 3U)) {
+        return 0;
+    }
+
+    // The registers of a running core cannot be saved
+    if (!swd_read_word(DBG_HCSR, &val) || !(val & S_HALT)) {
+        return 0;
+    }
+    if (!swd_read_core_registers(kStubRegs, TARGET_STUB_REGS, regs)) {
+        return 0;
+    }
+
+    if (function == TARGET_STUB_FILL || function == TARGET_STUB_BLANK) {
+        arg &= 0xFFU;
+    }
+
+    sys_call.breakpoint = workspace + TARGET_STUB_BREAKPOINT + 1U;
+    sys_call.static_base = 0U;
+    sys_call.stack_pointer = workspace + TARGET_STUB_WORKSPACE;
+
+    ok = swd_write_memory(workspace, (uint8_t *)kStubBlob, sizeof(kStubBlob)) &&
+         swd_flash_syscall_start(&sys_call, workspace + kStubEntry[function], address, size, arg, 0U) &&
+         swd_flash_syscall_result(result);
+
+    // A routine that did not finish is stopped, the registers are restored in any case
+    if (!ok) {
+        swd_write_word(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT);
+    }
+    if (!swd_write_core_registers(kStubRegs, regs, TARGET_STUB_REGS)) {
+        ok = 0;
+    }
+    return ok;
+}
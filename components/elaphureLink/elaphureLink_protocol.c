@@ -2,6 +2,8 @@
 
 #include "main/DAP_handle.h"
 
+#include "components/DAP/include/DAP.h"
+
 #include "lwip/err.h"
 #include "lwip/sockets.h"
 #include "lwip/sys.h"
@@ -16,8 +18,15 @@ extern void free_dap_ringbuf();
 
 extern uint32_t DAP_ExecuteCommand(const uint8_t *request, uint8_t *response);
 
+#define EL_STREAM_CHUNK_WORDS 256 // words per DAP_TransferBlock, one TAR auto-increment page
+
 struct el_context {
     bool is_async;
+    // set while a top-level stream block runs without the DAP lock
+    bool stream_unlocked;
+    // bytes received after the current packet, used by the streaming write
+    uint8_t *rx_buf;
+    int rx_len;
 };
 
 static struct el_context k_el_context;
@@ -65,7 +74,19 @@ int el_handshake_process(int fd, void *buffer, size_t len) {
 }
 
 void el_dap_data_process(void* buffer, size_t len) {
-    int res = DAP_ExecuteCommand(buffer, (uint8_t *)el_process_buffer);
+    const uint8_t *request = buffer;
+    int res;
+
+    if (len >= 2 && request[0] == EL_VENDOR_COMMAND_PERFIX && request[1] == EL_VENDOR_STREAM_BLOCK) {
+        // the stream waits on the socket, it takes the lock per chunk itself
+        k_el_context.stream_unlocked = true;
+        res = DAP_ExecuteCommand(buffer, (uint8_t *)el_process_buffer);
+        k_el_context.stream_unlocked = false;
+    } else {
+        DAP_Lock();
+        res = DAP_ExecuteCommand(buffer, (uint8_t *)el_process_buffer);
+        DAP_Unlock();
+    }
     res &= 0xFFFF;
 
     usbip_network_send(kSock, el_process_buffer, res, 0);
@@ -106,8 +127,12 @@ static int el_vendor_command_pre_process(uint8_t *base, int recved_len)
         if (offset + packet_len > recved_len)
             break;
 
+        // streaming write data follows the packet, let the handler consume it
+        k_el_context.rx_buf = base + offset + packet_len;
+        k_el_context.rx_len = recved_len - offset - packet_len;
         el_dap_data_process(base + offset, packet_len);
-        offset += packet_len;
+        offset = recved_len - k_el_context.rx_len;
+        k_el_context.rx_len = 0;
     }
 
     // already process done
@@ -198,6 +223,147 @@ int el_dap_work(uint8_t* base, size_t len)
     return 0;
 }
 
+static int el_stream_recv(uint8_t *buf, int size)
+{
+    int len = size < k_el_context.rx_len ? size : k_el_context.rx_len;
+
+    if (len > 0) {
+        memcpy(buf, k_el_context.rx_buf, len);
+        k_el_context.rx_buf += len;
+        k_el_context.rx_len -= len;
+    }
+
+    if (size > len) {
+        len = recv_all(kSock, buf + len, size - len, 0);
+        if (len <= 0)
+            return len;
+    }
+
+    return size;
+}
+
+uint32_t el_vendor_stream_block(const uint8_t *request, uint8_t *response)
+{
+    uint8_t tar_command[8];
+    uint8_t *block, *frame;
+    uint8_t dap_index, request_value, status, ack;
+    uint32_t count, done, received, n, tar;
+    int ret;
+
+    request += 2; // skip header (length field)
+
+    dap_index = request[0];
+    count = request[1] | (request[2] << 8);
+    request_value = request[3];
+    tar = request[4] | (request[5] << 8) | (request[6] << 16) | ((uint32_t)request[7] << 24);
+
+    status = EL_STREAM_STATUS_DONE;
+    ack = 0;
+    done = 0;
+    received = 0;
+    frame = NULL;
+    // request block, then the DAP response whose header is replaced by the frame header;
+    // el_process_buffer holds the outer response and must not be reused here
+    block = malloc(5 + 4 * EL_STREAM_CHUNK_WORDS + 4 + 4 * EL_STREAM_CHUNK_WORDS);
+
+    if (!k_el_context.stream_unlocked || el_process_buffer == NULL) {
+        // only valid as a top-level elaphureLink packet, not under the DAP lock
+        status = EL_STREAM_STATUS_ERROR;
+        goto end;
+    }
+    if (block == NULL) {
+        // drain through the outer response buffer, its header is restored below
+        frame = el_process_buffer;
+        status = EL_STREAM_STATUS_ERROR;
+        goto drain;
+    }
+    frame = block + 5 + 4 * EL_STREAM_CHUNK_WORDS;
+    if (!(request_value & DAP_TRANSFER_APnDP)) {
+        status = EL_STREAM_STATUS_ERROR;
+        goto drain;
+    }
+
+    while (done < count) {
+        n = (0x400 - (tar & 0x3FF)) / 4; // stay within the TAR auto-increment page
+        if (n > EL_STREAM_CHUNK_WORDS)
+            n = EL_STREAM_CHUNK_WORDS;
+        if (n > count - done)
+            n = count - done;
+
+        // DRW, the write data is received before taking the lock
+        block[0] = ID_DAP_TransferBlock;
+        block[1] = dap_index;
+        block[2] = n & 0xFF;
+        block[3] = (n >> 8) & 0xFF;
+        block[4] = request_value;
+        if (!(request_value & DAP_TRANSFER_RnW)) {
+            ret = el_stream_recv(&block[5], 4 * n);
+            if (ret <= 0)
+                goto end;
+            received += n;
+        }
+
+        // TAR
+        tar_command[0] = ID_DAP_Transfer;
+        tar_command[1] = dap_index;
+        tar_command[2] = 1;
+        tar_command[3] = DAP_TRANSFER_APnDP | DAP_TRANSFER_A2;
+        tar_command[4] = (tar >>  0) & 0xFF;
+        tar_command[5] = (tar >>  8) & 0xFF;
+        tar_command[6] = (tar >> 16) & 0xFF;
+        tar_command[7] = (tar >> 24) & 0xFF;
+
+        DAP_Lock();
+        DAP_ProcessCommand(tar_command, frame);
+        ack = frame[2];
+        if (ack == DAP_TRANSFER_OK) {
+            DAP_ProcessCommand(block, frame);
+            ack = frame[3];
+            n = frame[1] | (frame[2] << 8);
+        } else {
+            n = 0;
+        }
+        DAP_Unlock();
+
+        if ((request_value & DAP_TRANSFER_RnW) && n) {
+            frame[0] = EL_VENDOR_COMMAND_PERFIX;
+            frame[1] = EL_STREAM_STATUS_DATA;
+            frame[2] = ((4 * n) >> 8) & 0xFF;
+            frame[3] = (4 * n) & 0xFF;
+            usbip_network_send(kSock, frame, 4 + 4 * n, 0);
+        }
+
+        done += n;
+        tar += 4 * n;
+        if (ack != DAP_TRANSFER_OK)
+            break;
+    }
+
+drain:
+    // keep the stream in sync when a write stopped early
+    if (!(request_value & DAP_TRANSFER_RnW)) {
+        for (n = 4 * (count - received); n; n -= ret) {
+            ret = el_stream_recv(frame, n > 1024 ? 1024 : n);
+            if (ret <= 0)
+                break;
+        }
+    }
+
+end:
+    free(block);
+    if (el_process_buffer != NULL)
+        el_process_buffer[0] = EL_VENDOR_COMMAND_PERFIX;
+
+    response[0] = status;
+    response[1] = 0;
+    response[2] = 3;
+    response[3] = done & 0xFF;
+    response[4] = (done >> 8) & 0xFF;
+    response[5] = ack;
+
+    return 7;
+}
+
 uint32_t el_native_command_passthrough(const uint8_t *request, uint8_t *response)
 {
     int ret;
@@ -226,7 +392,6 @@ uint32_t el_vendor_command(const uint8_t *request, uint8_t *response)
         ret = el_native_command_passthrough(request, response);
         break;
     case EL_VENDOR_SCOPE_ENTER:
-        memset(&k_el_context, 0, sizeof(struct el_context));
         k_el_context.is_async = true;
         *response++ = 0; // status
         *response++ = 0;
@@ -240,6 +405,9 @@ uint32_t el_vendor_command(const uint8_t *request, uint8_t *response)
         *response++ = 0;
         ret = 4;
         break;
+    case EL_VENDOR_STREAM_BLOCK:
+        ret = el_vendor_stream_block(request, response);
+        break;
     default:
         break;
     }
@@ -14,6 +14,23 @@
 #define EL_NATIVE_COMMAND_PASSTHROUGH   0x1
 #define EL_VENDOR_SCOPE_ENTER           0x2
 #define EL_VENDOR_SCOPE_EXIT            0x3
+#define EL_VENDOR_STREAM_BLOCK          0x4
+
+/*
+ * Streaming transfer block (EL_VENDOR_STREAM_BLOCK)
+ *
+ * request:  [0x88][0x04][len = 8][dap index][count:16 LE][transfer request][TAR:32 LE]
+ *           write: count * 4 bytes of raw data follow the packet on the socket
+ * response: read:  zero or more data frames [0x88][0x01][len][data]
+ *           final: [0x88][0x00][len = 3][count:16 LE][transfer response]
+ *
+ * The probe writes TAR at each 1KB boundary, so the AP must be set up for
+ * 32-bit accesses with auto increment. The DAP lock is only held per chunk,
+ * never while waiting on the socket. Only accepted as a top-level packet.
+ */
+#define EL_STREAM_STATUS_DONE           0x0
+#define EL_STREAM_STATUS_DATA           0x1
+#define EL_STREAM_STATUS_ERROR          0xFF
 
 typedef struct
 {
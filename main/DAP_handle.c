@@ -6,6 +6,8 @@
  *          2020.11.11 support WinUSB mode
  *          2021.02.17 support SWO
  *          2021.10.03 try to handle unlink behavior
+ *          2026.10.19 handle DAP_TransferAbort out of band
+ *          2026.10.19 serialize DAP command execution between services
  *
  * @copyright Copyright (c) 2021
  *
@@ -54,6 +56,9 @@ typedef struct
 
 #define DAP_HANDLE_SIZE (sizeof(DapPacket_t))
 
+// While waiting for a response, look for an abort request this often
+#define DAP_ABORT_POLL_MS 5
+
 
 extern int kSock;
 extern TaskHandle_t kDAPTaskHandle;
@@ -72,7 +77,35 @@ static uint32_t swo_data_num;
 static RingbufHandle_t dap_dataIN_handle = NULL;
 static RingbufHandle_t dap_dataOUT_handle = NULL;
 static SemaphoreHandle_t data_response_mux = NULL;
+static SemaphoreHandle_t dap_lock_mux = NULL;
+
 
+/**
+ * @brief Create the lock that serializes DAP command execution.
+ * The usbip/elaphureLink server and the on-probe services (e.g. the XSVF player)
+ * share the same SWJ port, so only one of them may drive it at a time.
+ * The lock is not recursive: every transport takes it once around a single
+ * DAP_ProcessCommand/DAP_ExecuteCommand call, and nothing below that takes it again.
+ * The one exception is the elaphureLink stream block, which runs unlocked and
+ * takes the lock around each chunk once its data has been received.
+ */
+void DAP_Lock_Init(void)
+{
+    if (dap_lock_mux == NULL)
+        dap_lock_mux = xSemaphoreCreateMutex();
+}
+
+void DAP_Lock(void)
+{
+    if (dap_lock_mux != NULL)
+        xSemaphoreTake(dap_lock_mux, portMAX_DELAY);
+}
+
+void DAP_Unlock(void)
+{
+    if (dap_lock_mux != NULL)
+        xSemaphoreGive(dap_lock_mux);
+}
 
 void malloc_dap_ringbuf() {
     if (data_response_mux && xSemaphoreTake(data_response_mux, portMAX_DELAY) == pdTRUE)
@@ -104,12 +137,25 @@ void free_dap_ringbuf() {
 }
 
 
-void handle_dap_data_request(usbip_stage2_header *header, uint32_t length)
+/**
+ * @brief Queue a DAP request for DAP_Thread
+ *
+ * @return 1 if a response will follow, 0 otherwise
+ */
+int handle_dap_data_request(usbip_stage2_header *header, uint32_t length)
 {
     uint8_t *data_in = (uint8_t *)header;
     data_in = &(data_in[sizeof(usbip_stage2_header)]);
     // Point to the beginning of the URB packet
 
+    // DAP_TransferAbort has no response and must not wait behind the
+    // command that it is supposed to abort.
+    if (data_in[0] == ID_DAP_TransferAbort) {
+        send_stage2_submit_data_fast(header, NULL, 0);
+        DAP_TransferAbort = 1U;
+        return 0;
+    }
+
 #if (USE_WINUSB == 1)
     send_stage2_submit_data_fast(header, NULL, 0);
 
@@ -129,6 +175,8 @@ void handle_dap_data_request(usbip_stage2_header *header, uint32_t length)
     // dap_respond = DAP_ProcessCommand((uint8_t *)data_in, (uint8_t *)data_out);
     // //handle_dap_data_response(header);
     // send_stage2_submit(header, 0, 0);
+
+    return 1;
 }
 
 void handle_swo_trace_response(usbip_stage2_header *header)
@@ -225,7 +273,9 @@ void DAP_Thread(void *argument)
                 item->buf[0] = ID_DAP_ExecuteCommands;
             }
 
+            DAP_Lock();
             resLength = DAP_ProcessCommand((uint8_t *)item->buf, (uint8_t *)DAPDataProcessed.buf); // use first 4 byte to save length
+            DAP_Unlock();
             resLength &= 0xFFFF;                                                                   // res length in lower 16 bits
 
             vRingbufferReturnItem(dap_dataIN_handle, (void *)item); // process done.
@@ -252,8 +302,15 @@ int fast_reply(uint8_t *buf, uint32_t length, int dap_req_num)
     if (dap_req_num > 0) {
         DapPacket_t *item;
         size_t packetSize = 0;
-        item = (DapPacket_t *)xRingbufferReceiveUpTo(dap_dataOUT_handle, &packetSize,
-                                                     portMAX_DELAY, DAP_HANDLE_SIZE);
+        // The host may give up on a long running command, keep an eye on the socket
+        do {
+            item = (DapPacket_t *)xRingbufferReceiveUpTo(dap_dataOUT_handle, &packetSize,
+                                                         pdMS_TO_TICKS(DAP_ABORT_POLL_MS), DAP_HANDLE_SIZE);
+            if (packetSize == 0 && !DAP_TransferAbort && usbip_abort_pending()) {
+                DAP_TransferAbort = 1U;
+            }
+        } while (packetSize == 0);
+
         if (packetSize == DAP_HANDLE_SIZE) {
 #if (USE_WINUSB == 1)
             send_stage2_submit_data_fast((usbip_stage2_header *)buf, item->buf, item->length);
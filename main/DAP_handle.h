@@ -10,10 +10,14 @@ enum reset_handle_t
     DELETE_HANDLE = 2,
 };
 
-void handle_dap_data_request(usbip_stage2_header *header, uint32_t length);
+int handle_dap_data_request(usbip_stage2_header *header, uint32_t length);
 void handle_swo_trace_response(usbip_stage2_header *header);
 void handle_dap_unlink();
 
+void DAP_Lock_Init(void);
+void DAP_Lock(void);
+void DAP_Unlock(void);
+
 int fast_reply(uint8_t *buf, uint32_t length, int dap_req_num);
 
 #endif
\ No newline at end of file
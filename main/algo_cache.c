@@ -0,0 +1,194 @@
+/**
+ * @file algo_cache.c
+ * @brief Flash algorithm cache in NVS, keyed by SHA-256
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * A flash algorithm (the FLASH_CMD_ALGO payload of the flash service) is stored
+ * once and then referenced by the SHA-256 of that payload. The index lives in
+ * its own NVS blob and every slot keeps a use stamp, so the least recently used
+ * algorithm is evicted when all slots are taken.
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "sdkconfig.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "main/wifi_configuration.h"
+#include "main/algo_cache.h"
+
+#include "esp_log.h"
+#include "nvs.h"
+#include "mbedtls/sha256.h"
+
+#if (USE_FLASH_SERVER == 1)
+
+#define ALGO_CACHE_NAMESPACE "flash_algo"
+#define ALGO_CACHE_INDEX_KEY "index"
+
+typedef struct {
+    uint8_t hash[ALGO_CACHE_HASH_SIZE];
+    uint32_t size;
+    uint32_t stamp;     // last use, 0 = free
+} algo_cache_entry_t;
+
+typedef struct {
+    uint32_t stamp;
+    algo_cache_entry_t entry[ALGO_CACHE_SLOTS];
+} algo_cache_index_t;
+
+static algo_cache_index_t algo_cache_index;
+
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v)
+{
+    *p++ = (uint8_t)(v >> 0);
+    *p++ = (uint8_t)(v >> 8);
+    *p++ = (uint8_t)(v >> 16);
+    *p++ = (uint8_t)(v >> 24);
+    return p;
+}
+
+static void algo_cache_key(char *key, uint32_t slot)
+{
+    snprintf(key, 16, "algo%u", (unsigned)slot);
+}
+
+static int algo_cache_open(nvs_handle *handle)
+{
+    size_t len = sizeof(algo_cache_index);
+
+    if (nvs_open(ALGO_CACHE_NAMESPACE, NVS_READWRITE, handle) != ESP_OK)
+        return -1;
+
+    // A missing or outdated index starts an empty cache
+    if (nvs_get_blob(*handle, ALGO_CACHE_INDEX_KEY, &algo_cache_index, &len) != ESP_OK ||
+        len != sizeof(algo_cache_index))
+        memset(&algo_cache_index, 0, sizeof(algo_cache_index));
+    return 0;
+}
+
+static void algo_cache_close(nvs_handle handle, uint8_t dirty)
+{
+    if (dirty) {
+        nvs_set_blob(handle, ALGO_CACHE_INDEX_KEY, &algo_cache_index, sizeof(algo_cache_index));
+        nvs_commit(handle);
+    }
+    nvs_close(handle);
+}
+
+static int algo_cache_find(const uint8_t *hash)
+{
+    int slot;
+
+    for (slot = 0; slot < ALGO_CACHE_SLOTS; slot++) {
+        if (algo_cache_index.entry[slot].stamp &&
+            memcmp(algo_cache_index.entry[slot].hash, hash, ALGO_CACHE_HASH_SIZE) == 0)
+            return slot;
+    }
+    return -1;
+}
+
+void algo_cache_hash(const uint8_t *data, uint32_t size, uint8_t *hash)
+{
+    mbedtls_sha256_ret(data, size, hash, 0);
+}
+
+int algo_cache_store(const uint8_t *hash, const uint8_t *data, uint32_t size)
+{
+    nvs_handle handle;
+    char key[16];
+    int slot, n;
+
+    if (size > ALGO_CACHE_MAX_SIZE || algo_cache_open(&handle) < 0)
+        return -1;
+
+    slot = algo_cache_find(hash);
+    if (slot < 0) {
+        // Free slot first, then the least recently used one
+        slot = 0;
+        for (n = 0; n < ALGO_CACHE_SLOTS; n++) {
+            if (algo_cache_index.entry[n].stamp < algo_cache_index.entry[slot].stamp)
+                slot = n;
+        }
+
+        algo_cache_key(key, slot);
+        algo_cache_index.entry[slot].stamp = 0;
+        if (nvs_set_blob(handle, key, data, size) != ESP_OK) {
+            nvs_erase_key(handle, key);
+            algo_cache_close(handle, 1);
+            return -1;
+        }
+        memcpy(algo_cache_index.entry[slot].hash, hash, ALGO_CACHE_HASH_SIZE);
+        algo_cache_index.entry[slot].size = size;
+    }
+
+    algo_cache_index.entry[slot].stamp = ++algo_cache_index.stamp;
+    algo_cache_close(handle, 1);
+    return 0;
+}
+
+uint8_t *algo_cache_load(const uint8_t *hash, uint32_t *size)
+{
+    nvs_handle handle;
+    uint8_t *data;
+    char key[16];
+    size_t len;
+    int slot;
+
+    if (algo_cache_open(&handle) < 0)
+        return NULL;
+
+    slot = algo_cache_find(hash);
+    if (slot < 0) {
+        algo_cache_close(handle, 0);
+        return NULL;
+    }
+
+    len = algo_cache_index.entry[slot].size;
+    data = malloc(len);
+    algo_cache_key(key, slot);
+    if (data == NULL || nvs_get_blob(handle, key, data, &len) != ESP_OK ||
+        len != algo_cache_index.entry[slot].size) {
+        free(data);
+        algo_cache_close(handle, 0);
+        return NULL;
+    }
+
+    algo_cache_index.entry[slot].stamp = ++algo_cache_index.stamp;
+    algo_cache_close(handle, 1);
+
+    *size = len;
+    return data;
+}
+
+int algo_cache_list(uint8_t *out)
+{
+    nvs_handle handle;
+    uint8_t *p = out + 1;
+    int slot, n;
+
+    if (algo_cache_open(&handle) < 0)
+        return -1;
+    algo_cache_close(handle, 0);
+
+    // [count] then [hash:32 bytes][size:32][stamp:32] per algorithm
+    for (slot = 0, n = 0; slot < ALGO_CACHE_SLOTS; slot++) {
+        if (algo_cache_index.entry[slot].stamp == 0)
+            continue;
+        memcpy(p, algo_cache_index.entry[slot].hash, ALGO_CACHE_HASH_SIZE);
+        p += ALGO_CACHE_HASH_SIZE;
+        p = put_u32(p, algo_cache_index.entry[slot].size);
+        p = put_u32(p, algo_cache_index.entry[slot].stamp);
+        n++;
+    }
+    out[0] = n;
+    return p - out;
+}
+
+#endif
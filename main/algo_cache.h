@@ -0,0 +1,23 @@
+#ifndef _ALGO_CACHE_H_
+#define _ALGO_CACHE_H_
+
+#include <stdint.h>
+
+#define ALGO_CACHE_HASH_SIZE 32
+#define ALGO_CACHE_SLOTS     8
+
+#ifdef CONFIG_IDF_TARGET_ESP8266
+    #define ALGO_CACHE_MAX_SIZE 4096
+#else
+    #define ALGO_CACHE_MAX_SIZE 16384
+#endif
+
+// algo_cache_list output size
+#define ALGO_CACHE_LIST_SIZE (1 + ALGO_CACHE_SLOTS * (ALGO_CACHE_HASH_SIZE + 8))
+
+void algo_cache_hash(const uint8_t *data, uint32_t size, uint8_t *hash);
+int algo_cache_store(const uint8_t *hash, const uint8_t *data, uint32_t size);
+uint8_t *algo_cache_load(const uint8_t *hash, uint32_t *size);
+int algo_cache_list(uint8_t *out);
+
+#endif
@@ -55,4 +55,78 @@
  */
 #define USE_FORCE_SYSRESETREQ_AFTER_FLASH 0
 
+
+/**
+ * @brief Enable this option to stream SWD block writes with overrun detection
+ *
+ * When a DAP_TransferBlock or a swd_host block write stores at least 16 words
+ * through a MEM-AP DRW register in SPI mode, ORUNDETECT is enabled in
+ * CTRL/STAT and every write is sent without waiting for its ACK. The next
+ * word is prepared while the previous one is still on the wire. STICKYORUN is checked once at the end of the
+ * block; on any error the TAR is rewound and the block is written again in
+ * normal mode. Only used when the AP auto-increments the address, so it
+ * targets memory downloads and not FIFO registers.
+ *
+ * Only available for ESP32C3 and ESP32S3.
+ *
+ */
+#define USE_SWD_OVERRUN_STREAM 0
+
+
+/**
+ * @brief Enable this option to fuse SPI SWD reads into a single transaction
+ *
+ * The request, ACK, data and parity of a read are clocked as one SPI
+ * transaction, and the data phase of a write is sent together with the idle
+ * cycles. The ACK is checked afterwards. Reads are only fused when the host
+ * enabled the data phase on WAIT/FAULT (DAP_SWD_Configure), otherwise they
+ * keep separate header and data transactions. If a fused read gets no valid
+ * ACK, the line is reset and the transfer is done again in split mode.
+ *
+ * Only used in SPI mode.
+ *
+ */
+#define USE_SPI_FUSED_TRANSFER 0
+
+
+/**
+ * @brief Enable this option to use SPI for JTAG at high clock rates
+ *
+ * TCK comes from the SPI clock, TDI and TDO are routed to the SPI data
+ * lines in full duplex and TMS stays a GPIO. Every run of cycles with a
+ * constant TMS level is shifted as one SPI transaction.
+ *
+ * Only available for ESP32, ESP32C3 and ESP32S3.
+ *
+ */
+#define USE_SPI_JTAG 0
+
+
+/**
+ * @brief Enable this option to program several SWD targets in lockstep
+ *
+ * Every bus in SWD_GANG_PINS (DAP_config.h) has its own SWCLK and SWDIO. All
+ * buses are clocked together in GPIO mode, so writing the same image to N
+ * targets takes about as long as writing it to one. Each bus reports its own
+ * result, and a bus that fails drops out without stopping the others. The first
+ * bus shares its pins with the normal SWD port.
+ *
+ * Only available for ESP32 and ESP32S3.
+ *
+ */
+#define USE_SWD_GANG 0
+
+
+/**
+ * @brief Enable this option to cache read-only target memory on the probe
+ *
+ * The host declares read-only ranges with the Memory Cache vendor command.
+ * Reads through swd_read_memory (memory vendor commands, GDB server) fill
+ * the cache and repeated reads of the same flash are served without SWD
+ * traffic. The cache is dropped on writes, flash algorithm execution, reset
+ * and on request. Uses 16 KB of RAM, 4 KB on ESP8266.
+ *
+ */
+#define USE_MEM_CACHE 0
+
 #endif
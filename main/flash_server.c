@@ -0,0 +1,737 @@
+/**
+ * @file flash_server.c
+ * @brief On-probe flash programming with CMSIS flash algorithms
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * The host uploads the flash algorithm once and then streams the image. The
+ * probe keeps the target busy: while program_page runs on one target RAM
+ * buffer, the next page is received and written to the other buffer, and the
+ * erase of a sector runs while its first page is being received.
+ *
+ * All values are little endian. Every command is answered with a status byte:
+ *
+ *   FLASH_CMD_ALGO     [algo_start:32][blob_size:32][init:32][uninit:32]
+ *                      [erase_sector:32][program_page:32][breakpoint:32]
+ *                      [static_base:32][stack_pointer:32][buffer0:32][buffer1:32]
+ *                      [blob]
+ *                      -> [status]
+ *   FLASH_CMD_PROGRAM  [address:32][size:32][page_size:32][sector_size:32][data]
+ *                      -> [status][fail_address:32][receive_us:32][write_us:32]
+ *                         [erase_us:32][program_us:32][total_us:32]
+ *   FLASH_CMD_DELTA    [address:32][size:32][page_size:32][sector_size:32][crc:32]...
+ *                      -> [status][changed sector bitmap]
+ *                      [data of the changed sectors]
+ *                      -> same as FLASH_CMD_PROGRAM
+ *   FLASH_CMD_RAM      [address:32][size:32][data]
+ *                      -> [status]
+ *   FLASH_CMD_ALGO_HASH [sha256:32 bytes]
+ *                      -> [status]
+ *   FLASH_CMD_ALGO_LIST -> [status][count][sha256:32 bytes, size:32, stamp:32]...
+ *   FLASH_CMD_IMAGE    [sha256:32 bytes][address:32][size:32][page_size:32]
+ *                      [sector_size:32][crc:32][data]
+ *                      -> same as FLASH_CMD_PROGRAM
+ *
+ * FLASH_CMD_ALGO resets the target into the halted state. FLASH_CMD_PROGRAM
+ * erases every sector it touches, so the address must be sector aligned, and
+ * the last page is padded with 0xFF. The erase and program times are the time
+ * the probe waited for the target, the part that was not hidden by the overlap.
+ *
+ * FLASH_CMD_DELTA sends the CRC-32 of every sector of the image first (the last
+ * one only over the image bytes). The probe reads the target flash, compares,
+ * and only the sectors whose CRC differs are sent, erased and programmed.
+ *
+ * Every algorithm loaded with FLASH_CMD_ALGO is kept in NVS (see algo_cache.c).
+ * FLASH_CMD_ALGO_HASH loads it again by the SHA-256 of the FLASH_CMD_ALGO
+ * payload (the 44 byte header and the blob), without uploading it.
+ *
+ * FLASH_CMD_IMAGE does a whole production run in one request, so a plain TCP
+ * client is enough: it loads the cached algorithm, erases and programs the
+ * image, compares the CRC-32 of the target flash with the one of the image and
+ * resets the target into the running state.
+ *
+ * With FLASH_CMD_LZ4 set in the command byte, the data is sent as one block per
+ * page (per FLASH_MAX_PAGE bytes for FLASH_CMD_RAM): [length:16] followed by an
+ * LZ4 block, or by the raw page when bit 15 of the length is set. Blocks are
+ * independent, so the probe decodes each one straight into its page buffer.
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "sdkconfig.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/param.h>
+
+#include "main/wifi_configuration.h"
+#include "main/DAP_handle.h"
+#include "main/algo_cache.h"
+
+#include "components/DAP/config/DAP_config.h"
+#include "components/DAP/include/DAP.h"
+#include "components/DAP/include/dap_utility.h"
+#include "components/DAP/include/swd_host.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include <lwip/netdb.h>
+
+#if (USE_FLASH_SERVER == 1)
+
+#define FLASH_MAX_PAGE      1024U
+#define FLASH_ALGO_HEADER   44U
+#define FLASH_BLOB_CHUNK    FLASH_MAX_PAGE
+
+#define FLASH_CMD_ALGO      0x01U
+#define FLASH_CMD_PROGRAM   0x02U
+#define FLASH_CMD_DELTA     0x03U
+#define FLASH_CMD_RAM       0x04U
+#define FLASH_CMD_ALGO_HASH 0x05U
+#define FLASH_CMD_ALGO_LIST 0x06U
+#define FLASH_CMD_IMAGE     0x07U
+#define FLASH_CMD_LZ4       0x80U   // flag: image data is sent as LZ4 blocks
+
+#define FLASH_LZ4_STORED    0x8000U // block length flag: the block is not compressed
+#define FLASH_LZ4_MAX       (FLASH_MAX_PAGE + FLASH_MAX_PAGE / 255U + 16U)
+
+#define FLASH_MAX_SECTORS   1024U
+
+#define FLASH_OK            0x00U
+#define FLASH_ERR_REQUEST   0x01U   // malformed request or no algorithm loaded
+#define FLASH_ERR_TARGET    0x02U   // SWD access failed
+#define FLASH_ERR_INIT      0x03U
+#define FLASH_ERR_ERASE     0x04U
+#define FLASH_ERR_PROGRAM   0x05U
+#define FLASH_ERR_CONNECT   0x06U   // connection closed in the middle of the data
+#define FLASH_ERR_DATA      0x07U   // LZ4 block does not decode to the expected size
+#define FLASH_ERR_NOT_CACHED 0x08U  // no cached algorithm with this hash
+#define FLASH_ERR_VERIFY    0x09U   // the CRC-32 read back does not match
+
+#define TIMESTAMP_US(t)     ((t) / (TIMESTAMP_CLOCK / 1000000U))
+
+// Flash algorithm, as uploaded by the host
+typedef struct {
+    uint8_t loaded;
+    uint32_t init;
+    uint32_t uninit;
+    uint32_t erase_sector;
+    uint32_t program_page;
+    program_syscall_t sys_call;
+    uint32_t buffer[2];
+} flash_algo_t;
+
+// Per-phase time of a program command, in timestamp ticks
+typedef struct {
+    uint32_t receive;
+    uint32_t write;
+    uint32_t erase;
+    uint32_t program;
+} flash_timing_t;
+
+// The function that currently runs on the target
+typedef struct {
+    uint32_t entry;
+    uint32_t address;
+    uint8_t error;
+} flash_pending_t;
+
+static flash_algo_t flash_algo;
+static uint8_t flash_page[FLASH_MAX_PAGE];
+static uint8_t flash_changed[FLASH_MAX_SECTORS / 8];
+static uint8_t flash_lz4[FLASH_LZ4_MAX];
+static uint8_t flash_list[1 + ALGO_CACHE_LIST_SIZE];
+
+
+static int flash_recv(int sock, void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    int ret;
+
+    while (len) {
+        ret = recv(sock, p, len, 0);
+        if (ret <= 0)
+            return -1;
+        p += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+// Receive the next piece of image data
+//   lz4:    the data is a [length:16] block, LZ4 compressed or stored
+//   return: 0 on success, -1 when the connection is closed, -2 on a bad block
+static int flash_recv_data(int sock, uint8_t *dst, uint32_t size, uint8_t lz4)
+{
+    uint8_t header[2];
+    uint32_t len;
+
+    if (!lz4)
+        return flash_recv(sock, dst, size);
+
+    if (flash_recv(sock, header, sizeof(header)) < 0)
+        return -1;
+    len = header[0] | (header[1] << 8);
+
+    if (len & FLASH_LZ4_STORED) {
+        len &= ~FLASH_LZ4_STORED;
+        if (len != size)
+            return -1;
+        return flash_recv(sock, dst, size);
+    }
+
+    // Decompressed straight into the page buffer
+    if (len > sizeof(flash_lz4) || flash_recv(sock, flash_lz4, len) < 0)
+        return -1;
+    if (Lz4DecodeBlock(flash_lz4, len, dst, size) != (int)size)
+        return -2;
+    return 0;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 0) | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v)
+{
+    *p++ = (uint8_t)(v >> 0);
+    *p++ = (uint8_t)(v >> 8);
+    *p++ = (uint8_t)(v >> 16);
+    *p++ = (uint8_t)(v >> 24);
+    return p;
+}
+
+// Reset the target into the halted state with the flash clock
+static uint8_t flash_connect(void)
+{
+    const uint8_t connect[] = {ID_DAP_Connect, DAP_PORT_SWD};
+    const uint8_t clock[] = {
+        ID_DAP_SWJ_Clock,
+        (uint8_t)(FLASH_SERVER_CLOCK >> 0), (uint8_t)(FLASH_SERVER_CLOCK >> 8),
+        (uint8_t)(FLASH_SERVER_CLOCK >> 16), (uint8_t)(FLASH_SERVER_CLOCK >> 24),
+    };
+    uint8_t response[8];
+
+    swd_invalidate_dap_state();
+    if (!swd_set_target_state_hw(RESET_PROGRAM))
+        return 0;
+
+    // swd_init went back to the default clock
+    DAP_ProcessCommand(connect, response);
+    DAP_ProcessCommand(clock, response);
+    return 1;
+}
+
+// Wait for the function running on the target
+//   timing: the waiting time is added to the phase of the function
+//   return: 1 on success, 0 when the function failed
+static uint8_t flash_wait(flash_pending_t *pending, flash_timing_t *timing)
+{
+    uint32_t start;
+    uint8_t ret;
+
+    if (pending->entry == 0)
+        return 1;
+
+    start = TIMESTAMP_GET();
+    ret = swd_flash_syscall_wait(pending->address, 0, FLASHALGO_RETURN_BOOL);
+    if (pending->error == FLASH_ERR_ERASE)
+        timing->erase += TIMESTAMP_GET() - start;
+    else
+        timing->program += TIMESTAMP_GET() - start;
+
+    pending->entry = 0;
+    return ret;
+}
+
+static uint8_t flash_start(flash_pending_t *pending, uint32_t entry, uint32_t address,
+                           uint32_t size, uint32_t buffer, uint8_t error)
+{
+    pending->entry = entry;
+    pending->address = address;
+    pending->error = error;
+    return swd_flash_syscall_start(&flash_algo.sys_call, entry, address, size, buffer, 0);
+}
+
+static void flash_parse_algo(const uint8_t *header)
+{
+    flash_algo.init = get_u32(header + 8);
+    flash_algo.uninit = get_u32(header + 12);
+    flash_algo.erase_sector = get_u32(header + 16);
+    flash_algo.program_page = get_u32(header + 20);
+    memcpy(&flash_algo.sys_call, header + 24, sizeof(program_syscall_t));
+    flash_algo.buffer[0] = get_u32(header + 36);
+    flash_algo.buffer[1] = get_u32(header + 40);
+}
+
+static uint8_t flash_load_algo(int sock)
+{
+    uint8_t header[FLASH_ALGO_HEADER];
+    uint8_t hash[ALGO_CACHE_HASH_SIZE];
+    uint32_t algo_start, blob_size, offset, size;
+    uint8_t status = FLASH_OK;
+    uint8_t *cache = NULL;
+
+    if (flash_recv(sock, header, sizeof(header)) < 0)
+        return FLASH_ERR_CONNECT;
+
+    algo_start = get_u32(header + 0);
+    blob_size = get_u32(header + 4);
+    flash_parse_algo(header);
+    flash_algo.loaded = 0;
+
+    // Keep a copy of the whole payload for the cache when it fits
+    if (blob_size <= ALGO_CACHE_MAX_SIZE - FLASH_ALGO_HEADER) {
+        cache = malloc(FLASH_ALGO_HEADER + blob_size);
+        if (cache)
+            memcpy(cache, header, FLASH_ALGO_HEADER);
+    }
+
+    DAP_Lock();
+    if (!flash_connect())
+        status = FLASH_ERR_TARGET;
+
+    // The blob is consumed even after an error, so the stream stays in sync
+    for (offset = 0; offset < blob_size; offset += size) {
+        size = MIN(blob_size - offset, FLASH_BLOB_CHUNK);
+        if (flash_recv(sock, flash_page, size) < 0) {
+            status = FLASH_ERR_CONNECT;
+            break;
+        }
+        if (status == FLASH_OK && !swd_write_memory(algo_start + offset, flash_page, size))
+            status = FLASH_ERR_TARGET;
+        if (cache)
+            memcpy(cache + FLASH_ALGO_HEADER + offset, flash_page, size);
+    }
+    DAP_Unlock();
+
+    if (status == FLASH_OK && cache) {
+        algo_cache_hash(cache, FLASH_ALGO_HEADER + blob_size, hash);
+        algo_cache_store(hash, cache, FLASH_ALGO_HEADER + blob_size);
+    }
+    free(cache);
+
+    flash_algo.loaded = (status == FLASH_OK);
+    return status;
+}
+
+// Load an algorithm from the cache, by the SHA-256 of its FLASH_CMD_ALGO payload
+static uint8_t flash_load_hash(const uint8_t *hash)
+{
+    uint32_t size;
+    uint8_t status = FLASH_OK;
+    uint8_t *data;
+
+    flash_algo.loaded = 0;
+    data = algo_cache_load(hash, &size);
+    if (data == NULL)
+        return FLASH_ERR_NOT_CACHED;
+    if (size < FLASH_ALGO_HEADER || get_u32(data + 4) != size - FLASH_ALGO_HEADER) {
+        free(data);
+        return FLASH_ERR_NOT_CACHED;
+    }
+    flash_parse_algo(data);
+
+    DAP_Lock();
+    if (!flash_connect() ||
+        !swd_write_memory(get_u32(data + 0), data + FLASH_ALGO_HEADER, size - FLASH_ALGO_HEADER))
+        status = FLASH_ERR_TARGET;
+    DAP_Unlock();
+    free(data);
+
+    flash_algo.loaded = (status == FLASH_OK);
+    return status;
+}
+
+static uint8_t flash_load_cached_algo(int sock)
+{
+    uint8_t hash[ALGO_CACHE_HASH_SIZE];
+
+    if (flash_recv(sock, hash, sizeof(hash)) < 0)
+        return FLASH_ERR_CONNECT;
+    return flash_load_hash(hash);
+}
+
+static uint8_t flash_check_request(uint32_t address, uint32_t page_size, uint32_t sector_size)
+{
+    return flash_algo.loaded && page_size && page_size <= FLASH_MAX_PAGE &&
+           sector_size >= page_size && (sector_size % page_size) == 0 && (address % sector_size) == 0;
+}
+
+// Erase and program an image
+//   changed: bitmap of the sectors that are sent and programmed, NULL for all
+//   lz4:     one LZ4 block per page
+//   result:  fail address and timings
+static uint8_t flash_program(int sock, uint32_t address, uint32_t size, uint32_t page_size,
+                             uint32_t sector_size, const uint8_t *changed, uint8_t lz4, uint8_t *result)
+{
+    flash_timing_t timing = {0};
+    flash_pending_t pending = {0};
+    uint32_t offset, sector, chunk, buffer, start, t;
+    uint8_t status = FLASH_OK;
+    uint8_t *p;
+    int ret;
+
+    if (!flash_check_request(address, page_size, sector_size)) {
+        // Blocks cannot be drained without the page size, the session ends
+        if (lz4)
+            return FLASH_ERR_REQUEST;
+        // The image is still drained below
+        status = FLASH_ERR_REQUEST;
+        page_size = FLASH_MAX_PAGE;
+        sector_size = FLASH_MAX_PAGE;
+    }
+
+    start = TIMESTAMP_GET();
+    DAP_Lock();
+    swd_invalidate_dap_state();
+
+    // One init for erase and program, as for kAlgoSingleInitType algorithms
+    if (status == FLASH_OK &&
+        !swd_flash_syscall_exec(&flash_algo.sys_call, flash_algo.init, address, 0, 0, 0, FLASHALGO_RETURN_BOOL))
+        status = FLASH_ERR_INIT;
+
+    for (offset = 0, buffer = 0; offset < size; offset += chunk, address += chunk) {
+        // Unchanged sectors are neither sent nor touched
+        sector = offset / sector_size;
+        if (changed && (changed[sector / 8] & (1U << (sector % 8))) == 0) {
+            chunk = MIN(size - offset, sector_size);
+            continue;
+        }
+        chunk = MIN(size - offset, page_size);
+
+        // Erase the sector while its first page arrives
+        if (status == FLASH_OK && (address % sector_size) == 0) {
+            if (!flash_wait(&pending, &timing))
+                status = pending.error;
+            else if (!flash_start(&pending, flash_algo.erase_sector, address, 0, 0, FLASH_ERR_ERASE))
+                status = FLASH_ERR_TARGET;
+        }
+
+        // The rest of the image is drained after an error
+        t = TIMESTAMP_GET();
+        ret = flash_recv_data(sock, flash_page, chunk, lz4);
+        if (ret == -1) {
+            status = FLASH_ERR_CONNECT;
+            break;
+        }
+        if (ret < 0 && status == FLASH_OK)
+            status = FLASH_ERR_DATA;
+        memset(flash_page + chunk, 0xFF, page_size - chunk);
+        timing.receive += TIMESTAMP_GET() - t;
+        if (status != FLASH_OK)
+            continue;
+
+        // The other buffer is still being programmed
+        t = TIMESTAMP_GET();
+        if (!swd_write_memory(flash_algo.buffer[buffer], flash_page, page_size)) {
+            status = FLASH_ERR_TARGET;
+            continue;
+        }
+        timing.write += TIMESTAMP_GET() - t;
+
+        if (!flash_wait(&pending, &timing))
+            status = pending.error;
+        else if (!flash_start(&pending, flash_algo.program_page, address, page_size,
+                              flash_algo.buffer[buffer], FLASH_ERR_PROGRAM))
+            status = FLASH_ERR_TARGET;
+        buffer ^= 1;
+    }
+
+    // The target must be halted again before uninit, even after an error
+    if (!flash_wait(&pending, &timing) && status == FLASH_OK)
+        status = pending.error;
+    if (status != FLASH_ERR_REQUEST && status != FLASH_ERR_INIT)
+        swd_flash_syscall_exec(&flash_algo.sys_call, flash_algo.uninit, 0, 0, 0, 0, FLASHALGO_RETURN_BOOL);
+    DAP_Unlock();
+
+    p = put_u32(result, status == FLASH_OK ? 0 : pending.address);
+    p = put_u32(p, TIMESTAMP_US(timing.receive));
+    p = put_u32(p, TIMESTAMP_US(timing.write));
+    p = put_u32(p, TIMESTAMP_US(timing.erase));
+    p = put_u32(p, TIMESTAMP_US(timing.program));
+    put_u32(p, TIMESTAMP_US(TIMESTAMP_GET() - start));
+    return status;
+}
+
+// Write an image to target RAM
+//   lz4:    one LZ4 block per FLASH_MAX_PAGE bytes
+static uint8_t flash_write_ram(int sock, uint32_t address, uint32_t size, uint8_t lz4)
+{
+    uint32_t offset, chunk;
+    uint8_t status = FLASH_OK;
+    int ret;
+
+    DAP_Lock();
+    swd_invalidate_dap_state();
+
+    for (offset = 0; offset < size; offset += chunk) {
+        chunk = MIN(size - offset, FLASH_MAX_PAGE);
+        ret = flash_recv_data(sock, flash_page, chunk, lz4);
+        if (ret == -1) {
+            status = FLASH_ERR_CONNECT;
+            break;
+        }
+        if (ret < 0 && status == FLASH_OK)
+            status = FLASH_ERR_DATA;
+        if (status == FLASH_OK && !swd_write_memory(address + offset, flash_page, chunk))
+            status = FLASH_ERR_TARGET;
+    }
+
+    DAP_Unlock();
+    return status;
+}
+
+// Read the image back and compare its CRC-32
+static uint8_t flash_verify(uint32_t address, uint32_t size, uint32_t crc)
+{
+    uint32_t offset, chunk, value = 0;
+    uint8_t status = FLASH_OK;
+
+    DAP_Lock();
+    for (offset = 0; offset < size; offset += chunk) {
+        chunk = MIN(size - offset, FLASH_MAX_PAGE);
+        if (!swd_read_memory(address + offset, flash_page, chunk)) {
+            status = FLASH_ERR_TARGET;
+            break;
+        }
+        value = Crc32(value, flash_page, chunk);
+    }
+    DAP_Unlock();
+
+    if (status == FLASH_OK && value != crc)
+        status = FLASH_ERR_VERIFY;
+    return status;
+}
+
+// Program a whole image in one request: load the cached algorithm, erase,
+// program, verify and let the target run
+//   result: fail address and timings, as for FLASH_CMD_PROGRAM
+static uint8_t flash_program_image(int sock, uint8_t lz4, uint8_t *result)
+{
+    uint8_t header[ALGO_CACHE_HASH_SIZE + 20];
+    uint32_t address, size, crc;
+    uint8_t status, algo_status;
+
+    if (flash_recv(sock, header, sizeof(header)) < 0)
+        return FLASH_ERR_CONNECT;
+    address = get_u32(header + ALGO_CACHE_HASH_SIZE + 0);
+    size = get_u32(header + ALGO_CACHE_HASH_SIZE + 4);
+    crc = get_u32(header + ALGO_CACHE_HASH_SIZE + 16);
+
+    // Without an algorithm flash_program only drains the image
+    algo_status = flash_load_hash(header);
+    status = flash_program(sock, address, size, get_u32(header + ALGO_CACHE_HASH_SIZE + 8),
+                           get_u32(header + ALGO_CACHE_HASH_SIZE + 12), NULL, lz4, result);
+    if (algo_status != FLASH_OK && status != FLASH_ERR_CONNECT)
+        return algo_status;
+    if (status != FLASH_OK)
+        return status;
+
+    status = flash_verify(address, size, crc);
+    if (status != FLASH_OK)
+        return status;
+
+    DAP_Lock();
+    if (!swd_set_target_state_hw(RESET_RUN))
+        status = FLASH_ERR_TARGET;
+    DAP_Unlock();
+    return status;
+}
+
+// Compare the CRC-32 of every sector with the host image
+//   changed: bitmap of the sectors that differ
+static uint8_t flash_compare(int sock, uint32_t address, uint32_t size, uint32_t sector_size, uint8_t *changed)
+{
+    uint32_t offset, sector, pos, end, chunk, crc;
+    uint8_t host_crc[4];
+    uint8_t status = FLASH_OK;
+
+    DAP_Lock();
+    swd_invalidate_dap_state();
+
+    for (offset = 0, sector = 0; offset < size; offset += sector_size, sector++) {
+        if (flash_recv(sock, host_crc, sizeof(host_crc)) < 0) {
+            status = FLASH_ERR_CONNECT;
+            break;
+        }
+        if (status != FLASH_OK)
+            continue;
+
+        crc = 0;
+        end = MIN(size - offset, sector_size);
+        for (pos = 0; pos < end; pos += chunk) {
+            chunk = MIN(end - pos, FLASH_MAX_PAGE);
+            if (!swd_read_memory(address + offset + pos, flash_page, chunk)) {
+                status = FLASH_ERR_TARGET;
+                break;
+            }
+            crc = Crc32(crc, flash_page, chunk);
+        }
+        if (crc != get_u32(host_crc))
+            changed[sector / 8] |= 1U << (sector % 8);
+    }
+
+    DAP_Unlock();
+    return status;
+}
+
+static int flash_list_algos(void)
+{
+    int len = algo_cache_list(flash_list + 1);
+
+    if (len < 0) {
+        flash_list[0] = FLASH_ERR_NOT_CACHED;
+        return 1;
+    }
+    flash_list[0] = FLASH_OK;
+    return 1 + len;
+}
+
+static void flash_session(int sock)
+{
+    uint8_t header[16];
+    uint8_t response[1 + 24];
+    uint32_t address, size, page_size, sector_size, sectors;
+    uint8_t cmd, lz4;
+
+    while (flash_recv(sock, &cmd, 1) == 0) {
+        lz4 = cmd & FLASH_CMD_LZ4;
+
+        switch (cmd & ~FLASH_CMD_LZ4) {
+        case FLASH_CMD_ALGO:
+            response[0] = flash_load_algo(sock);
+            send(sock, response, 1, 0);
+            break;
+
+        case FLASH_CMD_ALGO_HASH:
+            response[0] = flash_load_cached_algo(sock);
+            send(sock, response, 1, 0);
+            break;
+
+        case FLASH_CMD_ALGO_LIST:
+            send(sock, flash_list, flash_list_algos(), 0);
+            break;
+
+        case FLASH_CMD_RAM:
+            if (flash_recv(sock, header, 8) < 0)
+                return;
+            response[0] = flash_write_ram(sock, get_u32(header + 0), get_u32(header + 4), lz4);
+            send(sock, response, 1, 0);
+            break;
+
+        case FLASH_CMD_IMAGE:
+            memset(response, 0, sizeof(response));
+            response[0] = flash_program_image(sock, lz4, response + 1);
+            os_printf("flash: image status %d, total %u us\r\n", response[0],
+                      (unsigned)get_u32(response + 21));
+            send(sock, response, sizeof(response), 0);
+            // An LZ4 image is not drained when the request is rejected
+            if (lz4 && (response[0] == FLASH_ERR_REQUEST || !flash_algo.loaded))
+                return;
+            break;
+
+        case FLASH_CMD_PROGRAM:
+        case FLASH_CMD_DELTA:
+            if (flash_recv(sock, header, sizeof(header)) < 0)
+                return;
+            address = get_u32(header + 0);
+            size = get_u32(header + 4);
+            page_size = get_u32(header + 8);
+            sector_size = get_u32(header + 12);
+
+            if ((cmd & ~FLASH_CMD_LZ4) == FLASH_CMD_DELTA) {
+                sectors = flash_check_request(address, page_size, sector_size) ?
+                          (size + sector_size - 1) / sector_size : 0;
+                if (sectors == 0 || sectors > FLASH_MAX_SECTORS) {
+                    // The CRC list cannot be skipped
+                    response[0] = FLASH_ERR_REQUEST;
+                    send(sock, response, 1, 0);
+                    return;
+                }
+
+                memset(flash_changed, 0, sizeof(flash_changed));
+                response[0] = flash_compare(sock, address, size, sector_size, flash_changed);
+                send(sock, response, 1, 0);
+                if (response[0] != FLASH_OK)
+                    break;
+                send(sock, flash_changed, (sectors + 7) / 8, 0);
+            }
+
+            memset(response, 0, sizeof(response));
+            response[0] = flash_program(sock, address, size, page_size, sector_size,
+                                        (cmd & ~FLASH_CMD_LZ4) == FLASH_CMD_DELTA ? flash_changed : NULL,
+                                        lz4, response + 1);
+            os_printf("flash: status %d, receive %u us, erase %u us, program %u us\r\n", response[0],
+                      (unsigned)get_u32(response + 5), (unsigned)get_u32(response + 13),
+                      (unsigned)get_u32(response + 17));
+            send(sock, response, sizeof(response), 0);
+            if (lz4 && response[0] == FLASH_ERR_REQUEST)
+                return;
+            break;
+
+        default:
+            // The stream cannot be resynchronised
+            response[0] = FLASH_ERR_REQUEST;
+            send(sock, response, 1, 0);
+            return;
+        }
+
+        if (response[0] == FLASH_ERR_CONNECT)
+            return;
+    }
+}
+
+void flash_server_task()
+{
+    int on = 1;
+    int listen_sock, sock;
+    struct sockaddr_in addr;
+    struct sockaddr_in source_addr;
+    uint32_t addr_len;
+
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(FLASH_SERVER_PORT);
+
+    listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (listen_sock < 0) {
+        os_printf("flash: unable to create socket: errno %d\r\n", errno);
+        vTaskDelete(NULL);
+    }
+
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, (void *)&on, sizeof(on));
+
+    if (bind(listen_sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listen_sock, 1) != 0) {
+        os_printf("flash: unable to listen: errno %d\r\n", errno);
+        close(listen_sock);
+        vTaskDelete(NULL);
+    }
+
+    while (1) {
+        addr_len = sizeof(source_addr);
+        sock = accept(listen_sock, (struct sockaddr *)&source_addr, &addr_len);
+        if (sock < 0) {
+            os_printf("flash: unable to accept connection: errno %d\r\n", errno);
+            continue;
+        }
+
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (void *)&on, sizeof(on));
+        flash_session(sock);
+
+        shutdown(sock, 0);
+        close(sock);
+    }
+}
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _FLASH_SERVER_H_
+#define _FLASH_SERVER_H_
+
+
+void flash_server_task();
+
+
+#endif
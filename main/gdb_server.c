@@ -0,0 +1,903 @@
+/**
+ * @file gdb_server.c
+ * @brief On-probe GDB remote serial protocol server for Cortex-M targets
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * GDB talks to the probe directly ("target remote dap.local:3333"), and every
+ * packet is served locally with the swd_host helpers. One step or one register
+ * dump costs a single round trip instead of dozens of DAP packets.
+ *
+ * Supported: ?, g/G, p/P, m/M, X, c/s, vCont, Z0-Z4/z0-z4, D, k,
+ * qSupported, qXfer:features:read, qXfer:memory-map:read, QStartNoAckMode,
+ * and "monitor reset [halt|run|sw]".
+ *
+ * Breakpoints (Z0 and Z1) use the FPB comparators, watchpoints (Z2-Z4) use the
+ * DWT comparators. The target is owned by this server while GDB is connected,
+ * so do not run a DAP host on the same target at the same time.
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "sdkconfig.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/param.h>
+
+#include "main/wifi_configuration.h"
+#include "main/DAP_handle.h"
+
+#include "components/DAP/config/DAP_config.h"
+#include "components/DAP/include/DAP.h"
+#include "components/DAP/include/swd_host.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include <lwip/netdb.h>
+
+#if (USE_GDB_SERVER == 1)
+
+#define GDB_PACKET_SIZE     1024U   // payload size, advertised in qSupported
+#define GDB_MAX_MEMORY      ((GDB_PACKET_SIZE - 4U) / 2U)
+#define GDB_REG_CNT         17U     // r0-r12, sp, lr, pc, xpsr, numbered as in DCRSR
+#define GDB_POLL_MS         50
+#define GDB_HALT_TIMEOUT    1000U
+#define GDB_MAX_FPB         8U
+#define GDB_MAX_DWT         4U
+
+#define NVIC_Addr    (0xe000e000)
+#define DBG_Addr     (0xe000edf0)
+
+#define DFSR_DWTTRAP 0x00000004
+#define DFSR_ALL     0x0000001F
+
+#define FP_CTRL      0xE0002000
+#define FP_COMP(n)   (0xE0002008 + 4U * (n))
+#define FP_CTRL_KEY  0x00000002
+#define FP_CTRL_EN   0x00000001
+
+#define DWT_CTRL        0xE0001000
+#define DWT_COMP(n)     (0xE0001020 + 16U * (n))
+#define DWT_MASK(n)     (0xE0001024 + 16U * (n))
+#define DWT_FUNCTION(n) (0xE0001028 + 16U * (n))
+#define DWT_MATCHED     0x01000000
+
+// The code region is usually flash, so GDB uses hardware breakpoints there.
+// Adjust to the target, GDB refuses memory accesses outside these regions.
+#define GDB_MEMORY_MAP                                                     \
+    "<?xml version=\"1.0\"?>"                                              \
+    "<!DOCTYPE memory-map PUBLIC \"+//IDN gnu.org//DTD GDB Memory Map V1.0//EN\" " \
+    "\"http://sourceware.org/gdb/gdb-memory-map.dtd\">"                    \
+    "<memory-map>"                                                         \
+    "<memory type=\"rom\" start=\"0x00000000\" length=\"0x20000000\"/>"    \
+    "<memory type=\"ram\" start=\"0x20000000\" length=\"0xe0000000\"/>"    \
+    "</memory-map>"
+
+#define GDB_TARGET_XML                                                     \
+    "<?xml version=\"1.0\"?>"                                              \
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"                          \
+    "<target><architecture>arm</architecture>"                             \
+    "<feature name=\"org.gnu.gdb.arm.m-profile\">"                         \
+    "<reg name=\"r0\" bitsize=\"32\"/><reg name=\"r1\" bitsize=\"32\"/>"   \
+    "<reg name=\"r2\" bitsize=\"32\"/><reg name=\"r3\" bitsize=\"32\"/>"   \
+    "<reg name=\"r4\" bitsize=\"32\"/><reg name=\"r5\" bitsize=\"32\"/>"   \
+    "<reg name=\"r6\" bitsize=\"32\"/><reg name=\"r7\" bitsize=\"32\"/>"   \
+    "<reg name=\"r8\" bitsize=\"32\"/><reg name=\"r9\" bitsize=\"32\"/>"   \
+    "<reg name=\"r10\" bitsize=\"32\"/><reg name=\"r11\" bitsize=\"32\"/>" \
+    "<reg name=\"r12\" bitsize=\"32\"/>"                                   \
+    "<reg name=\"sp\" bitsize=\"32\" type=\"data_ptr\"/>"                  \
+    "<reg name=\"lr\" bitsize=\"32\"/>"                                    \
+    "<reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\"/>"                  \
+    "<reg name=\"xpsr\" bitsize=\"32\"/>"                                  \
+    "</feature></target>"
+
+// Z packet types
+enum gdb_point_type_t
+{
+    GDB_POINT_SW = 0,
+    GDB_POINT_HW,
+    GDB_POINT_WRITE,
+    GDB_POINT_READ,
+    GDB_POINT_ACCESS,
+};
+
+typedef struct {
+    int sock;
+    uint8_t no_ack;
+    uint8_t running;
+    uint8_t interrupted;
+
+    uint8_t fpb_rev;
+    uint8_t fpb_cnt;
+    uint8_t dwt_cnt;
+    uint32_t fpb_comp[GDB_MAX_FPB];  // comparator value, 0 = free
+    uint32_t dwt_addr[GDB_MAX_DWT];
+    uint32_t dwt_mask[GDB_MAX_DWT];
+    uint8_t dwt_type[GDB_MAX_DWT];   // gdb_point_type_t, 0 = free
+
+    size_t pos;
+    size_t len;
+    uint8_t buf[256];
+} gdb_context_t;
+
+static gdb_context_t gdb_ctx;
+static char gdb_rx[GDB_PACKET_SIZE + 1];
+static char gdb_tx[GDB_PACKET_SIZE + 4];
+static uint8_t gdb_mem[GDB_MAX_MEMORY];
+
+static const char kHex[] = "0123456789abcdef";
+
+
+/*** socket ***/
+
+// Read one byte from the socket
+//   timeout_ms: < 0 blocks
+//   return: byte, -1 when the connection is closed, -2 on timeout
+static int gdb_getc(gdb_context_t *ctx, int timeout_ms)
+{
+    struct timeval tv;
+    fd_set fds;
+    int ret;
+
+    if (ctx->pos >= ctx->len) {
+        if (timeout_ms >= 0) {
+            FD_ZERO(&fds);
+            FD_SET(ctx->sock, &fds);
+            tv.tv_sec = timeout_ms / 1000;
+            tv.tv_usec = (timeout_ms % 1000) * 1000;
+            ret = select(ctx->sock + 1, &fds, NULL, NULL, &tv);
+            if (ret == 0)
+                return -2;
+            if (ret < 0)
+                return -1;
+        }
+        ret = recv(ctx->sock, ctx->buf, sizeof(ctx->buf), 0);
+        if (ret <= 0)
+            return -1;
+        ctx->pos = 0;
+        ctx->len = ret;
+    }
+
+    return ctx->buf[ctx->pos++];
+}
+
+static int hex_val(int c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// Receive one packet into gdb_rx, acks and stray interrupts are consumed here
+//   return: payload length, -1 when the connection is closed
+static int gdb_get_packet(gdb_context_t *ctx)
+{
+    uint8_t checksum;
+    int c, hi, lo;
+    int len;
+
+    while (1) {
+        do {
+            c = gdb_getc(ctx, -1);
+            if (c < 0)
+                return -1;
+        } while (c != '$');
+
+        len = 0;
+        checksum = 0;
+        while ((c = gdb_getc(ctx, -1)) != '#') {
+            if (c < 0)
+                return -1;
+            if (len < (int)GDB_PACKET_SIZE)
+                gdb_rx[len++] = (char)c;
+            checksum += (uint8_t)c;
+        }
+        gdb_rx[len] = '\0';
+
+        hi = hex_val(gdb_getc(ctx, -1));
+        lo = hex_val(gdb_getc(ctx, -1));
+
+        if (ctx->no_ack)
+            return len;
+        if (hi >= 0 && lo >= 0 && ((hi << 4) | lo) == checksum) {
+            send(ctx->sock, "+", 1, 0);
+            return len;
+        }
+        send(ctx->sock, "-", 1, 0);
+    }
+}
+
+// Send the reply that was built at gdb_tx + 1
+static void gdb_send(gdb_context_t *ctx, size_t len)
+{
+    uint8_t checksum = 0;
+    size_t i;
+
+    gdb_tx[0] = '$';
+    for (i = 1; i <= len; i++)
+        checksum += (uint8_t)gdb_tx[i];
+    gdb_tx[len + 1] = '#';
+    gdb_tx[len + 2] = kHex[checksum >> 4];
+    gdb_tx[len + 3] = kHex[checksum & 0xF];
+
+    send(ctx->sock, gdb_tx, len + 4, 0);
+}
+
+static void gdb_send_str(gdb_context_t *ctx, const char *str)
+{
+    size_t len = strlen(str);
+
+    memcpy(gdb_tx + 1, str, len);
+    gdb_send(ctx, len);
+}
+
+
+/*** encoding ***/
+
+static const char *gdb_parse_hex(const char *p, uint32_t *val)
+{
+    int v;
+
+    *val = 0;
+    while ((v = hex_val(*p)) >= 0) {
+        *val = (*val << 4) | (uint32_t)v;
+        p++;
+    }
+    return p;
+}
+
+static char *gdb_put_hex(char *out, const uint8_t *data, size_t len)
+{
+    while (len--) {
+        *out++ = kHex[*data >> 4];
+        *out++ = kHex[*data & 0xF];
+        data++;
+    }
+    return out;
+}
+
+// Registers are sent in target byte order
+static char *gdb_put_u32(char *out, uint32_t val)
+{
+    uint8_t bytes[4] = { val, val >> 8, val >> 16, val >> 24 };
+
+    return gdb_put_hex(out, bytes, 4);
+}
+
+static const char *gdb_parse_u32(const char *p, uint32_t *val)
+{
+    int i, hi, lo;
+
+    *val = 0;
+    for (i = 0; i < 4; i++) {
+        hi = hex_val(p[0]);
+        lo = hex_val(p[1]);
+        if (hi < 0 || lo < 0)
+            return NULL;
+        *val |= (uint32_t)((hi << 4) | lo) << (8 * i);
+        p += 2;
+    }
+    return p;
+}
+
+// qXfer read of a constant document
+static size_t gdb_xfer(char *out, const char *doc, const char *args)
+{
+    uint32_t offset, length;
+    size_t size = strlen(doc);
+
+    args = gdb_parse_hex(args, &offset);
+    if (*args++ != ',')
+        return 0;
+    gdb_parse_hex(args, &length);
+
+    if (length > GDB_PACKET_SIZE - 1)
+        length = GDB_PACKET_SIZE - 1;
+    if (offset >= size) {
+        out[0] = 'l';
+        return 1;
+    }
+    if (length >= size - offset) {
+        length = size - offset;
+        out[0] = 'l';
+    } else {
+        out[0] = 'm';
+    }
+    memcpy(out + 1, doc + offset, length);
+    return length + 1;
+}
+
+
+/*** target ***/
+
+static uint8_t gdb_wait_halted(void)
+{
+    uint32_t val, i;
+
+    for (i = 0; i < GDB_HALT_TIMEOUT; i++) {
+        if (!swd_read_word(DBG_HCSR, &val))
+            return 0;
+        if (val & S_HALT)
+            return 1;
+    }
+    return 0;
+}
+
+static uint8_t gdb_halt(void)
+{
+    if (!swd_write_word(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT))
+        return 0;
+    return gdb_wait_halted();
+}
+
+static uint8_t gdb_resume(uint8_t step)
+{
+    swd_write_word(NVIC_DFSR, DFSR_ALL);
+
+    if (!step)
+        return swd_write_word(DBG_HCSR, DBGKEY | C_DEBUGEN);
+
+    // C_MASKINTS may only change while halted
+    if (!swd_write_word(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT | C_MASKINTS))
+        return 0;
+    if (!swd_write_word(DBG_HCSR, DBGKEY | C_DEBUGEN | C_MASKINTS | C_STEP))
+        return 0;
+    if (!gdb_wait_halted())
+        return 0;
+    return swd_write_word(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT);
+}
+
+// Write the FPB and DWT comparators from the local copy
+static void gdb_write_points(gdb_context_t *ctx)
+{
+    uint32_t val;
+    uint32_t n;
+
+    swd_write_word(FP_CTRL, FP_CTRL_KEY | FP_CTRL_EN);
+    for (n = 0; n < ctx->fpb_cnt; n++)
+        swd_write_word(FP_COMP(n), ctx->fpb_comp[n]);
+
+    // The DWT is only accessible with TRCENA set, a reset may clear it
+    if (swd_read_word(DBG_EMCR, &val))
+        swd_write_word(DBG_EMCR, val | TRCENA);
+    for (n = 0; n < ctx->dwt_cnt; n++) {
+        swd_write_word(DWT_COMP(n), ctx->dwt_addr[n]);
+        swd_write_word(DWT_MASK(n), ctx->dwt_mask[n]);
+        // FUNCTION: 5 = read, 6 = write, 7 = access
+        swd_write_word(DWT_FUNCTION(n), ctx->dwt_type[n] == GDB_POINT_WRITE ? 6 :
+                                        ctx->dwt_type[n] == GDB_POINT_READ ? 5 :
+                                        ctx->dwt_type[n] == GDB_POINT_ACCESS ? 7 : 0);
+    }
+}
+
+static void gdb_clear_points(gdb_context_t *ctx)
+{
+    memset(ctx->fpb_comp, 0, sizeof(ctx->fpb_comp));
+    memset(ctx->dwt_type, 0, sizeof(ctx->dwt_type));
+    gdb_write_points(ctx);
+}
+
+static uint8_t gdb_set_breakpoint(gdb_context_t *ctx, uint32_t addr, uint8_t insert)
+{
+    uint32_t comp, match, replace;
+    uint32_t n;
+
+    if (ctx->fpb_rev == 0) {
+        // FPB v1 matches a word and selects the halfword with REPLACE
+        if (addr >= 0x20000000)
+            return 0;
+        match = addr & 0x1FFFFFFC;
+        replace = (addr & 2) ? 0x80000000 : 0x40000000;
+    } else {
+        match = addr & ~1U;
+        replace = 0;
+    }
+
+    for (n = 0; n < ctx->fpb_cnt; n++) {
+        comp = ctx->fpb_comp[n];
+        if (comp && (comp & ~0xC0000001U) == match)
+            break;
+    }
+
+    if (insert) {
+        if (n == ctx->fpb_cnt) {
+            for (n = 0; n < ctx->fpb_cnt && ctx->fpb_comp[n]; n++)
+                ;
+            if (n == ctx->fpb_cnt)
+                return 0;
+            ctx->fpb_comp[n] = match | 1U;
+        }
+        ctx->fpb_comp[n] |= replace;
+    } else {
+        if (n == ctx->fpb_cnt)
+            return 1;
+        ctx->fpb_comp[n] &= ~replace;
+        if (replace == 0 || (ctx->fpb_comp[n] & 0xC0000000) == 0)
+            ctx->fpb_comp[n] = 0;
+    }
+
+    return swd_write_word(FP_COMP(n), ctx->fpb_comp[n]);
+}
+
+static uint8_t gdb_set_watchpoint(gdb_context_t *ctx, uint8_t type, uint32_t addr, uint32_t len, uint8_t insert)
+{
+    uint32_t mask, n;
+
+    // The DWT matches an aligned power of two
+    if (len == 0 || (len & (len - 1)) || (addr & (len - 1)))
+        return 0;
+    for (mask = 0; (1U << mask) < len; mask++)
+        ;
+
+    for (n = 0; n < ctx->dwt_cnt; n++) {
+        if (insert ? (ctx->dwt_type[n] == 0) :
+                     (ctx->dwt_type[n] == type && ctx->dwt_addr[n] == addr && ctx->dwt_mask[n] == mask))
+            break;
+    }
+    if (n == ctx->dwt_cnt)
+        return insert ? 0 : 1;
+
+    ctx->dwt_type[n] = insert ? type : 0;
+    ctx->dwt_addr[n] = addr;
+    ctx->dwt_mask[n] = mask;
+    gdb_write_points(ctx);
+    return 1;
+}
+
+// Halt the target and find the debug resources
+static uint8_t gdb_attach(gdb_context_t *ctx)
+{
+    const uint8_t connect[] = {ID_DAP_Connect, DAP_PORT_SWD};
+    const uint8_t clock[] = {
+        ID_DAP_SWJ_Clock,
+        (uint8_t)(GDB_SERVER_CLOCK >> 0), (uint8_t)(GDB_SERVER_CLOCK >> 8),
+        (uint8_t)(GDB_SERVER_CLOCK >> 16), (uint8_t)(GDB_SERVER_CLOCK >> 24),
+    };
+    uint8_t response[8];
+    uint32_t val;
+
+    swd_invalidate_dap_state();
+    if (!swd_init_debug())
+        return 0;
+    DAP_ProcessCommand(connect, response);
+    DAP_ProcessCommand(clock, response);
+
+    if (!gdb_halt())
+        return 0;
+
+    if (!swd_read_word(FP_CTRL, &val))
+        return 0;
+    ctx->fpb_rev = val >> 28;
+    ctx->fpb_cnt = MIN(((val >> 8) & 0x70) | ((val >> 4) & 0xF), GDB_MAX_FPB);
+
+    if (swd_read_word(DBG_EMCR, &val))
+        swd_write_word(DBG_EMCR, val | TRCENA);
+    if (!swd_read_word(DWT_CTRL, &val))
+        return 0;
+    ctx->dwt_cnt = MIN(val >> 28, GDB_MAX_DWT);
+
+    gdb_clear_points(ctx);
+    return 1;
+}
+
+static void gdb_detach(gdb_context_t *ctx)
+{
+    const uint8_t disconnect[] = {ID_DAP_Disconnect};
+    uint8_t response[8];
+
+    swd_invalidate_dap_state();
+    gdb_clear_points(ctx);
+    swd_write_word(NVIC_DFSR, DFSR_ALL);
+    swd_write_word(DBG_HCSR, DBGKEY);
+    DAP_ProcessCommand(disconnect, response);
+}
+
+// monitor reset [halt|run|sw]
+static uint8_t gdb_reset(gdb_context_t *ctx, const char *args)
+{
+    const uint8_t clock[] = {
+        ID_DAP_SWJ_Clock,
+        (uint8_t)(GDB_SERVER_CLOCK >> 0), (uint8_t)(GDB_SERVER_CLOCK >> 8),
+        (uint8_t)(GDB_SERVER_CLOCK >> 16), (uint8_t)(GDB_SERVER_CLOCK >> 24),
+    };
+    uint8_t response[8];
+    uint8_t ret;
+
+    // Both reset paths halt at the reset vector
+    if (strcmp(args, "sw") == 0)
+        ret = swd_set_target_state_sw(RESET_PROGRAM);
+    else
+        ret = swd_set_target_state_hw(RESET_PROGRAM);
+
+    // swd_init went back to the default clock
+    DAP_ProcessCommand(clock, response);
+    gdb_write_points(ctx);
+
+    if (ret && strcmp(args, "run") == 0)
+        ret = gdb_resume(0);
+    return ret;
+}
+
+
+/*** packets ***/
+
+static size_t gdb_stop_reply(gdb_context_t *ctx, char *out)
+{
+    static const char *kWatch[] = { "watch", "rwatch", "awatch" };
+    uint32_t dfsr, val, n;
+
+    if (ctx->interrupted) {
+        ctx->interrupted = 0;
+        return sprintf(out, "S02");
+    }
+
+    if (swd_read_word(NVIC_DFSR, &dfsr) && (dfsr & DFSR_DWTTRAP)) {
+        for (n = 0; n < ctx->dwt_cnt; n++) {
+            if (ctx->dwt_type[n] && swd_read_word(DWT_FUNCTION(n), &val) && (val & DWT_MATCHED))
+                return sprintf(out, "T05%s:%08x;", kWatch[ctx->dwt_type[n] - GDB_POINT_WRITE],
+                               (unsigned)ctx->dwt_addr[n]);
+        }
+    }
+    return sprintf(out, "S05");
+}
+
+static size_t gdb_query(gdb_context_t *ctx, const char *p, char *out)
+{
+    char cmd[32];
+    uint32_t i;
+    int hi, lo;
+
+    if (strncmp(p, "qSupported", 10) == 0) {
+        return sprintf(out, "PacketSize=%x;qXfer:memory-map:read+;qXfer:features:read+;"
+                            "QStartNoAckMode+;vContSupported+", GDB_PACKET_SIZE);
+    }
+    if (strncmp(p, "qXfer:features:read:target.xml:", 31) == 0)
+        return gdb_xfer(out, GDB_TARGET_XML, p + 31);
+    if (strncmp(p, "qXfer:memory-map:read::", 23) == 0)
+        return gdb_xfer(out, GDB_MEMORY_MAP, p + 23);
+    if (strcmp(p, "qAttached") == 0)
+        return sprintf(out, "1");
+    if (strcmp(p, "QStartNoAckMode") == 0) {
+        gdb_send_str(ctx, "OK");
+        ctx->no_ack = 1;
+        return (size_t)-1;
+    }
+
+    if (strncmp(p, "qRcmd,", 6) == 0) {
+        p += 6;
+        for (i = 0; i < sizeof(cmd) - 1; i++, p += 2) {
+            hi = hex_val(p[0]);
+            lo = hex_val(p[1]);
+            if (hi < 0 || lo < 0)
+                break;
+            cmd[i] = (char)((hi << 4) | lo);
+        }
+        cmd[i] = '\0';
+
+        if (strcmp(cmd, "reset") == 0)
+            return sprintf(out, "%s", gdb_reset(ctx, "halt") ? "OK" : "E01");
+        if (strncmp(cmd, "reset ", 6) == 0)
+            return sprintf(out, "%s", gdb_reset(ctx, cmd + 6) ? "OK" : "E01");
+        return 0;
+    }
+
+    return 0;
+}
+
+static size_t gdb_memory(char type, const char *p, int len, char *out)
+{
+    uint32_t addr, size, i;
+    const char *end = gdb_rx + len;
+    uint8_t *dst;
+    int hi, lo;
+
+    p = gdb_parse_hex(p, &addr);
+    if (*p++ != ',')
+        return sprintf(out, "E01");
+    p = gdb_parse_hex(p, &size);
+
+    if (type == 'm') {
+        size = MIN(size, GDB_MAX_MEMORY);
+        if (!swd_read_memory(addr, gdb_mem, size))
+            return sprintf(out, "E01");
+        return gdb_put_hex(out, gdb_mem, size) - out;
+    }
+
+    if (*p++ != ':' || size > GDB_MAX_MEMORY)
+        return sprintf(out, "E01");
+
+    dst = gdb_mem;
+    for (i = 0; i < size && p < end; i++) {
+        if (type == 'M') {
+            hi = hex_val(p[0]);
+            lo = hex_val(p[1]);
+            if (hi < 0 || lo < 0)
+                return sprintf(out, "E01");
+            *dst++ = (uint8_t)((hi << 4) | lo);
+            p += 2;
+        } else if (*p == '}') {
+            *dst++ = (uint8_t)(p[1] ^ 0x20);
+            p += 2;
+        } else {
+            *dst++ = (uint8_t)*p++;
+        }
+    }
+    if (i != size)
+        return sprintf(out, "E01");
+    if (size && !swd_write_memory(addr, gdb_mem, size))
+        return sprintf(out, "E01");
+    return sprintf(out, "OK");
+}
+
+static size_t gdb_registers(char type, const char *p, char *out)
+{
+    static const uint8_t regsel[GDB_REG_CNT] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+    uint32_t regs[GDB_REG_CNT];
+    uint32_t n, val;
+    char *start = out;
+
+    switch (type) {
+    case 'g':
+        if (!swd_read_core_registers(regsel, GDB_REG_CNT, regs))
+            return sprintf(start, "E01");
+        for (n = 0; n < GDB_REG_CNT; n++)
+            out = gdb_put_u32(out, regs[n]);
+        return out - start;
+
+    case 'G':
+        for (n = 0; n < GDB_REG_CNT; n++) {
+            p = gdb_parse_u32(p, &regs[n]);
+            if (p == NULL)
+                return sprintf(out, "E01");
+        }
+        if (!swd_write_core_registers(regsel, regs, GDB_REG_CNT))
+            return sprintf(out, "E01");
+        return sprintf(out, "OK");
+
+    case 'p':
+        gdb_parse_hex(p, &n);
+        if (n >= GDB_REG_CNT)
+            return sprintf(out, "xxxxxxxx");
+        if (!swd_read_core_register(n, &val))
+            return sprintf(out, "E01");
+        return gdb_put_u32(out, val) - out;
+
+    default: // 'P'
+        p = gdb_parse_hex(p, &n);
+        if (*p++ != '=' || n >= GDB_REG_CNT)
+            return sprintf(out, "E01");
+        if (gdb_parse_u32(p, &val) == NULL || !swd_write_core_register(n, val))
+            return sprintf(out, "E01");
+        return sprintf(out, "OK");
+    }
+}
+
+static size_t gdb_point(gdb_context_t *ctx, uint8_t insert, const char *p, char *out)
+{
+    uint32_t type, addr, kind;
+    uint8_t ret;
+
+    p = gdb_parse_hex(p, &type);
+    if (*p++ != ',')
+        return sprintf(out, "E01");
+    p = gdb_parse_hex(p, &addr);
+    if (*p++ != ',')
+        return sprintf(out, "E01");
+    gdb_parse_hex(p, &kind);
+
+    switch (type) {
+    case GDB_POINT_SW:
+    case GDB_POINT_HW:
+        ret = gdb_set_breakpoint(ctx, addr, insert);
+        break;
+    case GDB_POINT_WRITE:
+    case GDB_POINT_READ:
+    case GDB_POINT_ACCESS:
+        ret = gdb_set_watchpoint(ctx, type, addr, kind, insert);
+        break;
+    default:
+        return 0;
+    }
+
+    return sprintf(out, "%s", ret ? "OK" : "E01");
+}
+
+// Continue or step, an optional address sets the PC first
+//   return: reply length, or -1 while the target is running
+static size_t gdb_run(gdb_context_t *ctx, uint8_t step, const char *p, char *out)
+{
+    uint32_t addr;
+
+    if (*p && hex_val(*p) >= 0) {
+        gdb_parse_hex(p, &addr);
+        if (!swd_write_core_register(15, addr))
+            return sprintf(out, "E01");
+    }
+
+    if (!gdb_resume(step))
+        return sprintf(out, "E01");
+    if (step)
+        return gdb_stop_reply(ctx, out);
+
+    ctx->running = 1;
+    return (size_t)-1;
+}
+
+// Handle one packet and send the reply
+//   return: 0 to go on, -1 to end the session
+static int gdb_handle_packet(gdb_context_t *ctx, int len)
+{
+    const char *p = gdb_rx + 1;
+    char *out = gdb_tx + 1;
+    size_t reply = 0;
+
+    // Commands from the host may have left SELECT and CSW anywhere
+    swd_invalidate_dap_state();
+
+    switch (gdb_rx[0]) {
+    case '?':
+        reply = gdb_stop_reply(ctx, out);
+        break;
+    case 'g':
+    case 'G':
+    case 'p':
+    case 'P':
+        reply = gdb_registers(gdb_rx[0], p, out);
+        break;
+    case 'm':
+    case 'M':
+    case 'X':
+        reply = gdb_memory(gdb_rx[0], p, len, out);
+        break;
+    case 'c':
+    case 's':
+        reply = gdb_run(ctx, gdb_rx[0] == 's', p, out);
+        break;
+    case 'Z':
+    case 'z':
+        reply = gdb_point(ctx, gdb_rx[0] == 'Z', p, out);
+        break;
+    case 'H':
+    case 'T':
+        reply = sprintf(out, "OK");
+        break;
+    case 'q':
+    case 'Q':
+        reply = gdb_query(ctx, gdb_rx, out);
+        break;
+    case 'v':
+        if (strcmp(gdb_rx, "vCont?") == 0) {
+            reply = sprintf(out, "vCont;c;C;s;S");
+        } else if (strncmp(gdb_rx, "vCont;", 6) == 0) {
+            // Single core, so only the first action matters
+            if (gdb_rx[6] == 'c' || gdb_rx[6] == 'C')
+                reply = gdb_run(ctx, 0, "", out);
+            else if (gdb_rx[6] == 's' || gdb_rx[6] == 'S')
+                reply = gdb_run(ctx, 1, "", out);
+            else
+                reply = sprintf(out, "E01");
+        }
+        break;
+    case 'D':
+        gdb_send_str(ctx, "OK");
+        return -1;
+    case 'k':
+        return -1;
+    default:
+        break;
+    }
+
+    if (reply != (size_t)-1)
+        gdb_send(ctx, reply);
+    return 0;
+}
+
+static void gdb_session(int sock)
+{
+    gdb_context_t *ctx = &gdb_ctx;
+    uint32_t val;
+    int len, c;
+
+    memset(ctx, 0, sizeof(gdb_context_t));
+    ctx->sock = sock;
+
+    DAP_Lock();
+    if (!gdb_attach(ctx)) {
+        DAP_Unlock();
+        os_printf("gdb: unable to attach to the target\r\n");
+        return;
+    }
+    DAP_Unlock();
+
+    while (1) {
+        if (ctx->running) {
+            // Only an interrupt may arrive while the target runs
+            c = gdb_getc(ctx, GDB_POLL_MS);
+            if (c == -1)
+                break;
+
+            DAP_Lock();
+            swd_invalidate_dap_state();
+            if (c == 0x03) {
+                ctx->interrupted = 1;
+                gdb_halt();
+            }
+            if (swd_read_word(DBG_HCSR, &val) && (val & S_HALT)) {
+                ctx->running = 0;
+                gdb_send(ctx, gdb_stop_reply(ctx, gdb_tx + 1));
+            }
+            DAP_Unlock();
+            continue;
+        }
+
+        len = gdb_get_packet(ctx);
+        if (len < 0)
+            break;
+
+        DAP_Lock();
+        len = gdb_handle_packet(ctx, len);
+        DAP_Unlock();
+        if (len < 0)
+            break;
+    }
+
+    DAP_Lock();
+    gdb_detach(ctx);
+    DAP_Unlock();
+}
+
+void gdb_server_task()
+{
+    int on = 1;
+    int listen_sock, sock;
+    struct sockaddr_in addr;
+    struct sockaddr_in source_addr;
+    uint32_t addr_len;
+
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(GDB_SERVER_PORT);
+
+    listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (listen_sock < 0) {
+        os_printf("gdb: unable to create socket: errno %d\r\n", errno);
+        vTaskDelete(NULL);
+    }
+
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, (void *)&on, sizeof(on));
+
+    if (bind(listen_sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listen_sock, 1) != 0) {
+        os_printf("gdb: unable to listen: errno %d\r\n", errno);
+        close(listen_sock);
+        vTaskDelete(NULL);
+    }
+
+    while (1) {
+        addr_len = sizeof(source_addr);
+        sock = accept(listen_sock, (struct sockaddr *)&source_addr, &addr_len);
+        if (sock < 0) {
+            os_printf("gdb: unable to accept connection: errno %d\r\n", errno);
+            continue;
+        }
+
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (void *)&on, sizeof(on));
+        gdb_session(sock);
+
+        shutdown(sock, 0);
+        close(sock);
+    }
+}
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _GDB_SERVER_H_
+#define _GDB_SERVER_H_
+
+
+void gdb_server_task();
+
+
+#endif
@@ -15,9 +15,13 @@
 #include "main/tcp_netconn.h"
 #include "main/kcp_server.h"
 #include "main/uart_bridge.h"
+#include "main/xsvf_player.h"
+#include "main/gdb_server.h"
+#include "main/flash_server.h"
 #include "main/timer.h"
 #include "main/wifi_configuration.h"
 #include "main/wifi_handle.h"
+#include "main/DAP_handle.h"
 
 #include "components/corsacOTA/src/corsacOTA.h"
 
@@ -38,6 +42,7 @@
 #include "mdns.h"
 
 extern void DAP_Setup(void);
+extern void SWJ_Calibrate(void);
 extern void DAP_Thread(void *argument);
 extern void SWO_Thread();
 
@@ -101,8 +106,10 @@ void app_main() {
     uart_bridge_init();
 #endif
     wifi_init();
-    DAP_Setup();
     timer_init();
+    DAP_Setup();
+    DAP_Lock_Init();
+    SWJ_Calibrate();
 
 #if (USE_MDNS == 1)
     mdns_setup();
@@ -146,4 +153,16 @@ void app_main() {
 #if (USE_UART_BRIDGE == 1)
     xTaskCreate(uart_bridge_task, "uart_server", UART_BRIDGE_TASK_STACK_SIZE, NULL, 2, NULL);
 #endif
+
+#if (USE_XSVF_PLAYER == 1)
+    xTaskCreate(xsvf_player_task, "xsvf_player", 3072, NULL, 5, NULL);
+#endif
+
+#if (USE_GDB_SERVER == 1)
+    xTaskCreate(gdb_server_task, "gdb_server", 4096, NULL, 5, NULL);
+#endif
+
+#if (USE_FLASH_SERVER == 1)
+    xTaskCreate(flash_server_task, "flash_server", 3072, NULL, 5, NULL);
+#endif
 }
@@ -2,6 +2,7 @@
  * @file timer.c
  * @brief Hardware timer for DAP timestamp
  * @change: 2021-02-18 Using the FRC2 timer
+ *          2026-10-19 Derive the count from esp_timer on esp32 targets
  *
  * @version 0.2
  * @date 2020-01-22
@@ -16,6 +17,8 @@
 
 #ifdef CONFIG_IDF_TARGET_ESP8266
     #include "hw_timer.h"
+#else
+    #include "esp_timer.h"
 #endif
 
 #include "freertos/FreeRTOS.h"
@@ -56,7 +59,8 @@ uint32_t get_timer_count()
 #ifdef CONFIG_IDF_TARGET_ESP8266
     return (uint32_t)frc2->count.data;
 #elif defined CONFIG_IDF_TARGET_ESP32 || defined CONFIG_IDF_TARGET_ESP32C3 || defined CONFIG_IDF_TARGET_ESP32S3
-    return 0;
+    // esp_timer runs at 1MHz, scale it to the same 5MHz count
+    return (uint32_t)(esp_timer_get_time() * 5);
 #else
     #error unknown hardware
 #endif
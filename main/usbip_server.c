@@ -9,6 +9,7 @@
 
 #include "components/USBIP/usb_handle.h"
 #include "components/USBIP/usb_descriptor.h"
+#include "components/DAP/include/DAP.h"
 
 #include "lwip/err.h"
 #include "lwip/sockets.h"
@@ -226,8 +227,8 @@ static int usbip_urb_process(uint8_t *base, uint32_t length)
                 if (dap_req_num > 0)
                     dap_req_num--;
             } else if (likely(ep == 1 && dir == USBIP_DIR_OUT)) {
-                dap_req_num++;
-                handle_dap_data_request(header, length);
+                if (handle_dap_data_request(header, length))
+                    dap_req_num++;
             } else if (ep == 0) {
                 unpack(base, sizeof(usbip_stage2_header));
                 handleUSBControlRequest(header);
@@ -306,6 +307,42 @@ int usbip_worker(uint8_t *base, uint32_t length, enum usbip_server_state_t *stat
     return 0;
 }
 
+/**
+ * @brief Look ahead in the socket for a request that wants the running DAP
+ *        command to stop: an UNLINK, or a DAP_TransferAbort on the DAP OUT
+ *        endpoint. Nothing is consumed, the URBs are handled later as usual.
+ *
+ * @return 1 if such a request is pending, 0 otherwise
+ */
+int usbip_abort_pending()
+{
+    static uint8_t peek_buf[256];
+    usbip_stage2_header *header;
+    int len, offset, sz;
+
+    len = recv(kSock, peek_buf, sizeof(peek_buf), MSG_PEEK | MSG_DONTWAIT);
+
+    offset = 0;
+    while (len - offset >= (int)sizeof(usbip_stage2_header)) {
+        header = (usbip_stage2_header *)(peek_buf + offset);
+        offset += sizeof(usbip_stage2_header);
+
+        if (ntohl(header->base.command) == USBIP_STAGE2_REQ_UNLINK)
+            return 1;
+        if (ntohl(header->base.command) != USBIP_STAGE2_REQ_SUBMIT ||
+            ntohl(header->base.direction) != USBIP_DIR_OUT)
+            continue;
+
+        sz = ntohl(header->u.cmd_submit.data_length);
+        if (sz > 0 && offset < len && ntohl(header->base.ep) == 1 &&
+            peek_buf[offset] == ID_DAP_TransferAbort)
+            return 1;
+        offset += sz;
+    }
+
+    return 0;
+}
+
 /**
  * @brief Pack the following packets(Offset 0x00 - 0x28):
  *       - cmd_submit
@@ -65,6 +65,8 @@ static const char *CO_TAG = "corsacOTA";
 
 extern void free_dap_ringbuf();
 extern uint32_t DAP_ExecuteCommand(const uint8_t *request, uint8_t *response);
+extern void DAP_Lock(void);
+extern void DAP_Unlock(void);
 
 static void co_websocket_process_dap(uint8_t *data, size_t len);
 
@@ -901,7 +903,9 @@ static void co_websocket_process_dap(uint8_t *data, size_t len) {
     max_offset = co_websocket_get_res_payload_offset(1500);
     buf = ws_process_buffer + max_offset;
 
+    DAP_Lock();
     res = DAP_ExecuteCommand(data, buf);
+    DAP_Unlock();
     res &= 0xFFFF;
 
     offset = co_websocket_get_res_payload_offset(res);
@@ -43,6 +43,24 @@ static struct {
 #define UART_BRIDGE_BAUDRATE 74880
 //
 
+// Stream an XSVF file to this port, the probe replies with a single "OK" or "FAIL ..." line
+#define USE_XSVF_PLAYER      0
+#define XSVF_PLAYER_PORT     3242
+#define XSVF_PLAYER_CLOCK    10000000 // JTAG clock in Hz
+//
+
+// GDB remote serial protocol server for Cortex-M, use "target remote dap.local:3333"
+#define USE_GDB_SERVER       0
+#define GDB_SERVER_PORT      3333
+#define GDB_SERVER_CLOCK     10000000 // SWD clock in Hz
+//
+
+// Flash programming service, the host uploads a CMSIS flash algorithm and streams the image
+#define USE_FLASH_SERVER     0
+#define FLASH_SERVER_PORT    3244
+#define FLASH_SERVER_CLOCK   10000000 // SWD clock in Hz
+//
+
 // DO NOT CHANGE
 #define USE_TCP_NETCONN 0
 
@@ -0,0 +1,643 @@
+/**
+ * @file xsvf_player.c
+ * @brief On-probe XSVF player
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * The XSVF file is streamed over a TCP connection and executed locally with
+ * JTAG_Sequence (which uses the SPI shifter when the JTAG SPI engine is active).
+ * TDO is compared on the probe, and a single result line is sent back when the
+ * file ends or the first error occurs:
+ *
+ *   "OK\n"
+ *   "FAIL <reason> at offset <n> command 0x<cc>\n"
+ *
+ * SVF is not interpreted here. Convert it on the host (e.g. with svf2xsvf) first.
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "sdkconfig.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/param.h>
+
+#include "main/wifi_configuration.h"
+#include "main/DAP_handle.h"
+
+#include "components/DAP/config/DAP_config.h"
+#include "components/DAP/include/DAP.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include <lwip/netdb.h>
+
+#if (USE_XSVF_PLAYER == 1)
+
+#define XSVF_MAX_BITS       4096U
+#define XSVF_MAX_BYTES      (XSVF_MAX_BITS / 8U)
+#define XSVF_RX_BUFFER_SIZE 512U
+
+// XSVF commands
+#define XCOMPLETE    0x00U
+#define XTDOMASK     0x01U
+#define XSIR         0x02U
+#define XSDR         0x03U
+#define XRUNTEST     0x04U
+#define XREPEAT      0x07U
+#define XSDRSIZE     0x08U
+#define XSDRTDO      0x09U
+#define XSETSDRMASKS 0x0AU
+#define XSDRINC      0x0BU
+#define XSDRB        0x0CU
+#define XSDRC        0x0DU
+#define XSDRE        0x0EU
+#define XSDRTDOB     0x0FU
+#define XSDRTDOC     0x10U
+#define XSDRTDOE     0x11U
+#define XSTATE       0x12U
+#define XENDIR       0x13U
+#define XENDDR       0x14U
+#define XSIR2        0x15U
+#define XCOMMENT     0x16U
+#define XWAIT        0x17U
+
+// TAP states, numbered as in the XSVF specification
+enum xsvf_tap_state_t
+{
+    TAP_RESET = 0,
+    TAP_IDLE,
+    TAP_DRSELECT,
+    TAP_DRCAPTURE,
+    TAP_DRSHIFT,
+    TAP_DREXIT1,
+    TAP_DRPAUSE,
+    TAP_DREXIT2,
+    TAP_DRUPDATE,
+    TAP_IRSELECT,
+    TAP_IRCAPTURE,
+    TAP_IRSHIFT,
+    TAP_IREXIT1,
+    TAP_IRPAUSE,
+    TAP_IREXIT2,
+    TAP_IRUPDATE,
+    TAP_STATE_NUM,
+};
+
+// next state for TMS=0 and TMS=1
+static const uint8_t kTapNext[TAP_STATE_NUM][2] = {
+    {TAP_IDLE, TAP_RESET},         // TAP_RESET
+    {TAP_IDLE, TAP_DRSELECT},      // TAP_IDLE
+    {TAP_DRCAPTURE, TAP_IRSELECT}, // TAP_DRSELECT
+    {TAP_DRSHIFT, TAP_DREXIT1},    // TAP_DRCAPTURE
+    {TAP_DRSHIFT, TAP_DREXIT1},    // TAP_DRSHIFT
+    {TAP_DRPAUSE, TAP_DRUPDATE},   // TAP_DREXIT1
+    {TAP_DRPAUSE, TAP_DREXIT2},    // TAP_DRPAUSE
+    {TAP_DRSHIFT, TAP_DRUPDATE},   // TAP_DREXIT2
+    {TAP_IDLE, TAP_DRSELECT},      // TAP_DRUPDATE
+    {TAP_IRCAPTURE, TAP_RESET},    // TAP_IRSELECT
+    {TAP_IRSHIFT, TAP_IREXIT1},    // TAP_IRCAPTURE
+    {TAP_IRSHIFT, TAP_IREXIT1},    // TAP_IRSHIFT
+    {TAP_IRPAUSE, TAP_IRUPDATE},   // TAP_IREXIT1
+    {TAP_IRPAUSE, TAP_IREXIT2},    // TAP_IRPAUSE
+    {TAP_IRSHIFT, TAP_IRUPDATE},   // TAP_IREXIT2
+    {TAP_IDLE, TAP_DRSELECT},      // TAP_IRUPDATE
+};
+
+typedef struct
+{
+    int sock;
+    uint8_t buf[XSVF_RX_BUFFER_SIZE];
+    int pos;
+    int len;
+    uint32_t offset; // file offset of the next byte
+} xsvf_stream_t;
+
+typedef struct
+{
+    uint8_t state;
+    uint8_t end_ir;
+    uint8_t end_dr;
+    uint8_t repeat;
+    uint8_t command;
+    uint32_t command_offset;
+    uint32_t run_test;
+    uint32_t sdr_size;
+    const char *error;
+} xsvf_context_t;
+
+// All vectors are kept LSB first, i.e. bit n of the shift is buf[n / 8] bit (n % 8)
+static uint8_t xsvf_tdi[XSVF_MAX_BYTES];
+static uint8_t xsvf_tdo_expected[XSVF_MAX_BYTES];
+static uint8_t xsvf_tdo_mask[XSVF_MAX_BYTES];
+static uint8_t xsvf_tdo[XSVF_MAX_BYTES];
+
+static xsvf_stream_t xsvf_stream;
+static xsvf_context_t xsvf_ctx;
+
+
+static int xsvf_read_byte(xsvf_stream_t *s, uint8_t *value)
+{
+    if (s->pos >= s->len) {
+        s->len = recv(s->sock, s->buf, sizeof(s->buf), 0);
+        s->pos = 0;
+        if (s->len <= 0) {
+            s->len = 0;
+            return -1;
+        }
+    }
+
+    *value = s->buf[s->pos++];
+    s->offset++;
+    return 0;
+}
+
+static int xsvf_read_u32(xsvf_stream_t *s, uint32_t *value)
+{
+    uint8_t b;
+    uint32_t v = 0;
+
+    for (int i = 0; i < 4; i++) {
+        if (xsvf_read_byte(s, &b) < 0)
+            return -1;
+        v = (v << 8) | b;
+    }
+
+    *value = v;
+    return 0;
+}
+
+/**
+ * @brief Read a vector of the given bit length.
+ * XSVF stores vectors MSB first, so the byte order is reversed on the fly.
+ */
+static int xsvf_read_vector(xsvf_stream_t *s, uint8_t *vector, uint32_t bits)
+{
+    uint32_t n = (bits + 7U) / 8U;
+
+    if (bits > XSVF_MAX_BITS)
+        return -1;
+
+    while (n--) {
+        if (xsvf_read_byte(s, &vector[n]) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+static void xsvf_tms_run(uint32_t tms, uint32_t count)
+{
+    uint8_t tdi = 0xFFU;
+    uint32_t n;
+
+    while (count) {
+        n = count > 64U ? 64U : count;
+        JTAG_Sequence((n & JTAG_SEQUENCE_TCK) | (tms ? JTAG_SEQUENCE_TMS : 0U), &tdi, NULL);
+        count -= n;
+    }
+}
+
+/**
+ * @brief Move the TAP to the target state along the shortest TMS path.
+ * Entering Test-Logic-Reset always clocks five TMS=1 cycles so the TAP is
+ * reset regardless of the tracked state.
+ */
+static void xsvf_goto_state(xsvf_context_t *ctx, uint8_t target)
+{
+    uint8_t prev[TAP_STATE_NUM], via[TAP_STATE_NUM], queue[TAP_STATE_NUM];
+    uint8_t path[TAP_STATE_NUM];
+    uint8_t head = 0, tail = 0, state, next, len, run;
+    uint32_t visited = 0;
+
+    if (target == TAP_RESET) {
+        xsvf_tms_run(1, 5);
+        ctx->state = TAP_RESET;
+        return;
+    }
+
+    if (ctx->state == target)
+        return;
+
+    queue[tail++] = ctx->state;
+    visited |= 1U << ctx->state;
+    while (head < tail) {
+        state = queue[head++];
+        if (state == target)
+            break;
+        for (int tms = 0; tms < 2; tms++) {
+            next = kTapNext[state][tms];
+            if (visited & (1U << next))
+                continue;
+            visited |= 1U << next;
+            prev[next] = state;
+            via[next] = tms;
+            queue[tail++] = next;
+        }
+    }
+
+    len = 0;
+    for (state = target; state != ctx->state; state = prev[state])
+        path[len++] = via[state];
+
+    // emit runs of equal TMS
+    while (len) {
+        run = 1;
+        while (run < len && path[len - 1 - run] == path[len - 1])
+            run++;
+        xsvf_tms_run(path[len - 1], run);
+        len -= run;
+    }
+
+    ctx->state = target;
+}
+
+/**
+ * @brief Shift bits through the current Shift-xR state.
+ * When exit is set, the last bit is clocked with TMS=1 and the TAP is left in Exit1-xR.
+ */
+static void xsvf_shift(xsvf_context_t *ctx, const uint8_t *tdi, uint8_t *tdo, uint32_t bits, int exit)
+{
+    uint32_t offset = 0, n, body;
+    uint8_t last_tdi, last_tdo;
+
+    memset(tdo, 0, (bits + 7U) / 8U);
+    if (bits == 0)
+        return;
+
+    body = exit ? bits - 1U : bits;
+    while (offset < body) {
+        n = body - offset > 64U ? 64U : body - offset;
+        // offset stays byte aligned, since only the final chunk may be shorter than 64 bits
+        JTAG_Sequence((n & JTAG_SEQUENCE_TCK) | JTAG_SEQUENCE_TDO, &tdi[offset / 8U], &tdo[offset / 8U]);
+        offset += n;
+    }
+
+    if (exit) {
+        last_tdi = (tdi[offset / 8U] >> (offset % 8U)) & 0x01U;
+        last_tdo = 0;
+        JTAG_Sequence(1U | JTAG_SEQUENCE_TMS | JTAG_SEQUENCE_TDO, &last_tdi, &last_tdo);
+        tdo[offset / 8U] |= (last_tdo & 0x01U) << (offset % 8U);
+        ctx->state = kTapNext[ctx->state][1];
+    }
+}
+
+static int xsvf_compare(const uint8_t *tdo, const uint8_t *expected, const uint8_t *mask, uint32_t bits)
+{
+    uint32_t n = bits / 8U;
+    uint8_t tail_mask;
+
+    for (uint32_t i = 0; i < n; i++) {
+        if ((tdo[i] ^ expected[i]) & mask[i])
+            return -1;
+    }
+
+    if (bits % 8U) {
+        tail_mask = (1U << (bits % 8U)) - 1U;
+        if ((tdo[n] ^ expected[n]) & mask[n] & tail_mask)
+            return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Wait in the current stable state for the given time.
+ * TCK keeps running with TMS=0 for short waits; long waits yield to other tasks.
+ */
+static void xsvf_wait(uint32_t usecs)
+{
+    uint32_t start, ticks;
+
+    if (usecs == 0)
+        return;
+
+    if (usecs >= 2000U) {
+        xsvf_tms_run(0, 64);
+        vTaskDelay(pdMS_TO_TICKS(usecs / 1000U) + 1);
+        return;
+    }
+
+    ticks = usecs * (TIMESTAMP_CLOCK / 1000000U);
+    start = TIMESTAMP_GET();
+    do {
+        xsvf_tms_run(0, 8);
+    } while ((uint32_t)(TIMESTAMP_GET() - start) < ticks);
+}
+
+static uint8_t xsvf_end_state(uint8_t value, uint8_t pause_state)
+{
+    return value ? pause_state : TAP_IDLE;
+}
+
+/**
+ * @brief Shift a DR vector, compare it and retry as XREPEAT allows.
+ * A failing compare re-enters Shift-DR through Pause-DR, as the XSVF reference player does.
+ */
+static int xsvf_shift_dr(xsvf_context_t *ctx, int begin, int exit, int compare)
+{
+    uint32_t run_test = ctx->run_test;
+    int attempts = compare ? ctx->repeat + 1 : 1;
+
+    if (begin)
+        xsvf_goto_state(ctx, TAP_DRSHIFT);
+
+    for (;;) {
+        xsvf_shift(ctx, xsvf_tdi, xsvf_tdo, ctx->sdr_size, exit);
+
+        if (!compare ||
+            xsvf_compare(xsvf_tdo, xsvf_tdo_expected, xsvf_tdo_mask, ctx->sdr_size) == 0)
+            break;
+
+        if (--attempts <= 0 || !exit) {
+            ctx->error = "TDO mismatch";
+            return -1;
+        }
+
+        xsvf_goto_state(ctx, TAP_DRPAUSE);
+        xsvf_goto_state(ctx, TAP_DRSHIFT);
+        run_test += run_test >> 2;
+    }
+
+    if (exit) {
+        xsvf_goto_state(ctx, ctx->end_dr);
+        if (run_test && ctx->end_dr == TAP_IDLE)
+            xsvf_wait(run_test);
+    }
+
+    return 0;
+}
+
+static int xsvf_shift_ir(xsvf_context_t *ctx, uint32_t bits)
+{
+    if (xsvf_read_vector(&xsvf_stream, xsvf_tdi, bits) < 0) {
+        ctx->error = bits > XSVF_MAX_BITS ? "vector too long" : "unexpected end of file";
+        return -1;
+    }
+
+    xsvf_goto_state(ctx, TAP_IRSHIFT);
+    xsvf_shift(ctx, xsvf_tdi, xsvf_tdo, bits, 1);
+    xsvf_goto_state(ctx, ctx->end_ir);
+    if (ctx->run_test && ctx->end_ir == TAP_IDLE)
+        xsvf_wait(ctx->run_test);
+
+    return 0;
+}
+
+/**
+ * @brief Execute the XSVF stream.
+ * @return 1 on XCOMPLETE, -1 on error
+ */
+static int xsvf_run(xsvf_context_t *ctx)
+{
+    xsvf_stream_t *s = &xsvf_stream;
+    uint8_t value, wait_state, end_state;
+    uint32_t length, usecs;
+    int ret;
+
+    memset(xsvf_tdo_mask, 0xFF, sizeof(xsvf_tdo_mask));
+    memset(xsvf_tdo_expected, 0, sizeof(xsvf_tdo_expected));
+
+    xsvf_goto_state(ctx, TAP_RESET);
+
+    for (;;) {
+        ctx->command_offset = s->offset;
+        if (xsvf_read_byte(s, &ctx->command) < 0) {
+            ctx->error = "unexpected end of file";
+            return -1;
+        }
+
+        ret = 0;
+        switch (ctx->command) {
+        case XCOMPLETE:
+            return 1;
+
+        case XTDOMASK:
+            ret = xsvf_read_vector(s, xsvf_tdo_mask, ctx->sdr_size);
+            break;
+
+        case XSIR:
+            if (xsvf_read_byte(s, &value) < 0) {
+                ret = -1;
+                break;
+            }
+            if (xsvf_shift_ir(ctx, value) < 0)
+                return -1;
+            break;
+
+        case XSIR2:
+            if (xsvf_read_byte(s, &value) < 0) {
+                ret = -1;
+                break;
+            }
+            length = value << 8;
+            if (xsvf_read_byte(s, &value) < 0) {
+                ret = -1;
+                break;
+            }
+            if (xsvf_shift_ir(ctx, length | value) < 0)
+                return -1;
+            break;
+
+        case XSDR:
+            ret = xsvf_read_vector(s, xsvf_tdi, ctx->sdr_size);
+            if (ret == 0 && xsvf_shift_dr(ctx, 1, 1, 1) < 0)
+                return -1;
+            break;
+
+        case XRUNTEST:
+            ret = xsvf_read_u32(s, &ctx->run_test);
+            break;
+
+        case XREPEAT:
+            ret = xsvf_read_byte(s, &ctx->repeat);
+            break;
+
+        case XSDRSIZE:
+            ret = xsvf_read_u32(s, &ctx->sdr_size);
+            if (ret == 0 && ctx->sdr_size > XSVF_MAX_BITS) {
+                ctx->error = "vector too long";
+                return -1;
+            }
+            break;
+
+        case XSDRTDO:
+        case XSDRTDOB:
+        case XSDRTDOC:
+        case XSDRTDOE:
+            ret = xsvf_read_vector(s, xsvf_tdi, ctx->sdr_size);
+            if (ret == 0)
+                ret = xsvf_read_vector(s, xsvf_tdo_expected, ctx->sdr_size);
+            if (ret == 0 &&
+                xsvf_shift_dr(ctx, ctx->command != XSDRTDOC,
+                              ctx->command == XSDRTDO || ctx->command == XSDRTDOE, 1) < 0)
+                return -1;
+            break;
+
+        case XSDRB:
+        case XSDRC:
+        case XSDRE:
+            ret = xsvf_read_vector(s, xsvf_tdi, ctx->sdr_size);
+            if (ret == 0)
+                xsvf_shift_dr(ctx, ctx->command == XSDRB, ctx->command == XSDRE, 0);
+            break;
+
+        case XSTATE:
+            ret = xsvf_read_byte(s, &value);
+            if (ret == 0) {
+                if (value >= TAP_STATE_NUM) {
+                    ctx->error = "invalid TAP state";
+                    return -1;
+                }
+                xsvf_goto_state(ctx, value);
+            }
+            break;
+
+        case XENDIR:
+            ret = xsvf_read_byte(s, &value);
+            ctx->end_ir = xsvf_end_state(value, TAP_IRPAUSE);
+            break;
+
+        case XENDDR:
+            ret = xsvf_read_byte(s, &value);
+            ctx->end_dr = xsvf_end_state(value, TAP_DRPAUSE);
+            break;
+
+        case XCOMMENT:
+            do {
+                ret = xsvf_read_byte(s, &value);
+            } while (ret == 0 && value != 0);
+            break;
+
+        case XWAIT:
+            ret = xsvf_read_byte(s, &wait_state);
+            if (ret == 0)
+                ret = xsvf_read_byte(s, &end_state);
+            if (ret == 0)
+                ret = xsvf_read_u32(s, &usecs);
+            if (ret == 0) {
+                if (wait_state >= TAP_STATE_NUM || end_state >= TAP_STATE_NUM) {
+                    ctx->error = "invalid TAP state";
+                    return -1;
+                }
+                xsvf_goto_state(ctx, wait_state);
+                xsvf_wait(usecs);
+                xsvf_goto_state(ctx, end_state);
+            }
+            break;
+
+        case XSETSDRMASKS:
+        case XSDRINC:
+        default:
+            ctx->error = "unsupported command";
+            return -1;
+        }
+
+        if (ret < 0) {
+            ctx->error = ctx->sdr_size > XSVF_MAX_BITS ? "vector too long" : "unexpected end of file";
+            return -1;
+        }
+    }
+}
+
+static void xsvf_dap_command(const uint8_t *request)
+{
+    uint8_t response[8];
+
+    DAP_ProcessCommand(request, response);
+}
+
+static void xsvf_session(int sock)
+{
+    xsvf_context_t *ctx = &xsvf_ctx;
+    char result[96];
+    int ret;
+
+    const uint8_t connect[] = {ID_DAP_Connect, DAP_PORT_JTAG};
+    const uint8_t clock[] = {
+        ID_DAP_SWJ_Clock,
+        (uint8_t)(XSVF_PLAYER_CLOCK >> 0), (uint8_t)(XSVF_PLAYER_CLOCK >> 8),
+        (uint8_t)(XSVF_PLAYER_CLOCK >> 16), (uint8_t)(XSVF_PLAYER_CLOCK >> 24),
+    };
+    const uint8_t disconnect[] = {ID_DAP_Disconnect};
+
+    memset(ctx, 0, sizeof(xsvf_context_t));
+    ctx->state = TAP_RESET;
+    ctx->end_ir = TAP_IDLE;
+    ctx->end_dr = TAP_IDLE;
+
+    xsvf_stream.sock = sock;
+    xsvf_stream.pos = 0;
+    xsvf_stream.len = 0;
+    xsvf_stream.offset = 0;
+
+    // The whole file runs under the DAP lock, so no host command can interleave with it
+    DAP_Lock();
+    xsvf_dap_command(connect);
+    xsvf_dap_command(clock);
+    ret = xsvf_run(ctx);
+    xsvf_dap_command(disconnect);
+    DAP_Unlock();
+
+    if (ret > 0) {
+        strcpy(result, "OK\n");
+    } else {
+        snprintf(result, sizeof(result), "FAIL %s at offset %u command 0x%02x\n",
+                 ctx->error, (unsigned)ctx->command_offset, ctx->command);
+    }
+    os_printf("xsvf: %s", result);
+    send(sock, result, strlen(result), 0);
+}
+
+void xsvf_player_task()
+{
+    int on = 1;
+    int listen_sock, sock;
+    struct sockaddr_in addr;
+    struct sockaddr_in source_addr;
+    uint32_t addr_len;
+
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(XSVF_PLAYER_PORT);
+
+    listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (listen_sock < 0) {
+        os_printf("xsvf: unable to create socket: errno %d\r\n", errno);
+        vTaskDelete(NULL);
+    }
+
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, (void *)&on, sizeof(on));
+
+    if (bind(listen_sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listen_sock, 1) != 0) {
+        os_printf("xsvf: unable to listen: errno %d\r\n", errno);
+        close(listen_sock);
+        vTaskDelete(NULL);
+    }
+
+    while (1) {
+        addr_len = sizeof(source_addr);
+        sock = accept(listen_sock, (struct sockaddr *)&source_addr, &addr_len);
+        if (sock < 0) {
+            os_printf("xsvf: unable to accept connection: errno %d\r\n", errno);
+            continue;
+        }
+
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (void *)&on, sizeof(on));
+        xsvf_session(sock);
+
+        shutdown(sock, 0);
+        close(sock);
+    }
+}
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _XSVF_PLAYER_H_
+#define _XSVF_PLAYER_H_
+
+
+void xsvf_player_task();
+
+
+#endif